@@ -55,6 +55,12 @@ enum ins_opcode_t
 	READ,  // Write data to a byte on memory
 	WRITE, // Read data from a byte on memory
 	SYSCALL,
+	MEMCPY, // Copy a block of bytes between two regions
+	MEMSET, // Fill a block of bytes of a region
+	MEMCMP, // Compare the first bytes of two regions
+	SET,	// Load a value in a register
+	LOOP,	// Decrement a register, jump while it is not zero
+	JNZ,	// Jump if a register is not zero
 };
 
 /* instructions executed by the CPU */
@@ -67,10 +73,21 @@ struct inst_t
 	arg_t arg_3;
 };
 
+/* Predecoded instruction, the operands are still read from text */
+struct dinst_t
+{
+	uint32_t op;	// Entry of the dispatch table of run_n()
+	uint32_t ncalc;	// Number of consecutive CALC starting here
+};
+
 struct code_seg_t
 {
 	struct inst_t *text;
+	struct dinst_t *dtext; // Predecoded text, see code_predecode()
 	uint32_t size;
+	int ref;	// Processes sharing the segment, see code_put()
+	void *map;	// Mapping of a binary image holding text, or NULL
+	size_t map_len;
 };
 
 struct trans_table_t
@@ -109,8 +126,23 @@ struct pcb_t
 	// Priority on execution (if supported), on-fly aka. changeable
 	// and this vale overwrites the default priority when it existed
 	uint32_t prio;
+#endif
+#ifdef CFS_SCHED
+	uint64_t vruntime;	 // Weighted run time, fixed point (CFS_VRT_SHIFT)
+	uint64_t exec_start;	 // Time slot of the last dispatch
+#endif
+#ifdef SCHED_STATS
+	uint64_t arrival;	 // Time slot of admission to the ready queue
+	uint64_t first_run;	 // Time slot of the first dispatch
+	uint64_t ready_since;	 // Time slot of the last (re)queueing
+	uint64_t wait;		 // Total time slots spent in ready queues
+	uint32_t nr_dispatch;	 // Number of dispatches
+	uint32_t run_slots;	 // CPU time slots consumed
 #endif
 	struct krnl_t *krnl;	
+	int last_cpu;		 // CPU which ran this process last, -1 if none
+	struct queue_t *q_link;	 // Queue currently holding this process
+	int q_idx;		 // Slot of this process in q_link
 	struct page_table_t *page_table; // Page table
 	uint32_t bp;			 // Break pointer
 };
@@ -9,5 +9,14 @@
  * Otherwise, return 1. */
 int run(struct pcb_t * proc);
 
+/* Execute up to [budget] instructions of a process and store in
+ * [*nr] the number actually executed. A run of CALC instructions is
+ * consumed at once. Stop at the end of the code or at the first
+ * instruction that fails, in which case 1 is returned. */
+int run_n(struct pcb_t * proc, uint32_t budget, uint32_t * nr);
+
+/* Fill the predecoded text of a loaded code segment */
+void code_predecode(struct code_seg_t * code);
+
 #endif
 
@@ -0,0 +1,54 @@
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include <stdint.h>
+
+/* Pseudo CPU ids, they sort before the real CPUs of a time slot */
+#define EVLOG_TIMER	-2	// "Time slot" header
+#define EVLOG_NOCPU	-1	// loader and any untagged thread
+
+enum evlog_kind {
+	EV_SLOT,	// Time slot %3llu
+	EV_LD_START,	// ld_routine
+	EV_LOADED,	// Loaded a process at [str], PID: [pid] PRIO: [arg]
+	EV_DISPATCH,	// CPU [cpu]: Dispatched process [pid]
+	EV_PUT,		// CPU [cpu]: Put process [pid] to run queue
+	EV_FINISH,	// CPU [cpu]: Processed [pid] has finished
+	EV_STOP,	// CPU [cpu] stopped
+	EV_TEXT,	// free form [str]
+};
+
+struct evlog_ev {
+	uint64_t slot;
+	uint32_t seq;	// order of the event in its thread
+	int cpu;
+	int pid;
+	int kind;
+	long arg;
+	char * str;	// owned by the log, freed once printed
+};
+
+/*
+ * Trace of the simulation. With EVLOG every thread appends binary
+ * events to its own single producer ring; a writer thread drains the
+ * rings and prints the events of the finished time slots ordered by
+ * (slot, cpu). Without EVLOG the events are printed right away.
+ */
+void evlog_start(void);
+
+/* Print everything left, all logging threads must have exited */
+void evlog_stop(void);
+
+/* Tag the events of the calling thread with [cpu] */
+void evlog_thread(int cpu);
+
+/* [str] is copied */
+void evlog(int kind, int pid, long arg, const char * str);
+
+/* Header of time slot [slot] */
+void evlog_slot(uint64_t slot);
+
+void evlog_printf(const char * fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,44 @@
+
+#ifndef LFQUEUE_H
+#define LFQUEUE_H
+
+#include <stddef.h>
+#include "common.h"
+
+#define LFQ_CACHELINE 64
+
+/*
+ * Bounded lock-free multi-producer/multi-consumer FIFO of pcb
+ * (D. Vyukov's array queue). Every cell carries a sequence number
+ * telling whether it is ready to be written or read at a given
+ * position, so producers and consumers only race on their own
+ * position counter with a CAS.
+ */
+struct lfq_cell_t {
+	size_t seq;
+	struct pcb_t * proc;
+};
+
+struct lfqueue_t {
+	struct lfq_cell_t * cell;
+	size_t mask;	// Number of cells - 1, cells is a power of 2
+	size_t enq_pos __attribute__((aligned(LFQ_CACHELINE)));
+	size_t deq_pos __attribute__((aligned(LFQ_CACHELINE)));
+} __attribute__((aligned(LFQ_CACHELINE)));
+
+/* [size] is rounded up to a power of 2. Return 0 on success */
+int lfq_init(struct lfqueue_t * q, size_t size);
+
+void lfq_destroy(struct lfqueue_t * q);
+
+/* Return 0 on success, -1 if the queue is full */
+int lfq_enqueue(struct lfqueue_t * q, struct pcb_t * proc);
+
+/* Return NULL if the queue is empty */
+struct pcb_t * lfq_dequeue(struct lfqueue_t * q);
+
+/* Number of queued pcb, only a snapshot under concurrent access */
+size_t lfq_size(struct lfqueue_t * q);
+
+#endif
+
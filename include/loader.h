@@ -3,7 +3,35 @@
 
 #include "common.h"
 
+/*
+ * Binary process image: this header followed by the packed inst_t
+ * array in the layout of the build, so load() maps it as the code
+ * segment without parsing. Text programs are converted by mkimage.
+ */
+#define IMG_MAGIC	0x474d4953	// "SIMG"
+#define IMG_VERSION	1
+
+struct img_hdr_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t inst_size;	// sizeof(struct inst_t) of the build
+	uint32_t priority;
+	uint32_t size;		// Number of instructions
+};
+
+/* Load a text program or a binary image. The code segment is shared
+ * by every process of the same path and must not be written */
 struct pcb_t * load(const char * path);
 
+/* Take a reference to the code of the program at [path], reading it
+ * if it is not loaded yet. Safe to call from several threads */
+struct code_seg_t * load_code(const char * path, uint32_t * priority);
+
+/* Drop a reference to a code segment, the last one frees it */
+void code_put(struct code_seg_t * code);
+
+/* Write the code of [proc] as a binary image. Return 0 on success */
+int save_image(struct pcb_t * proc, const char * path);
+
 #endif
 
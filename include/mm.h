@@ -152,10 +152,15 @@ struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 /* MEM/PHY protypes */
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *fpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_get_freerun(struct memphy_struct *mp, int order, addr_t *fpn);
+int MEMPHY_put_freerun(struct memphy_struct *mp, addr_t fpn, int order);
 int MEMPHY_read(struct memphy_struct * mp, addr_t addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, addr_t addr, BYTE data);
 int MEMPHY_dump(struct memphy_struct * mp);
+void MEMPHY_touch(struct memphy_struct *mp, addr_t fpn);
 int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg);
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size, int randomflg,
+                     const char *dir);
 
 /* print list */
 int print_list_fp(struct framephy_struct *fp);
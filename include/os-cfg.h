@@ -14,8 +14,64 @@
 #define MLQ_SCHED 1
 #define MAX_PRIO 140
 
+/*
+ * Ready queue backend of the per-CPU MLQ: mutex protected queue_t
+ * by default, or lock-free bounded MPMC rings of MLQ_LF_RING_SZ
+ * entries per priority level when MLQ_LOCKFREE is defined. A full
+ * ring spills over to a mutex protected queue_t of the level.
+ */
+//#define MLQ_LOCKFREE 1
+#define MLQ_LF_RING_SZ 256
+
+/*
+ * Cache affinity: a CPU may pass over up to MLQ_AFFINITY_WINDOW
+ * entries of a queue to pick one that last ran on it, and the head
+ * is passed over at most MLQ_AFFINITY_WINDOW times in a row
+ * (mutex backend only, 0 disables it)
+ */
+#define MLQ_AFFINITY_WINDOW 4
+
+/*
+ * Fair scheduler class: dispatch the process with the smallest
+ * weighted virtual runtime instead of the MLQ policy. The weight is
+ * derived from prio, so the MLQ config format is still used.
+ */
+//#define CFS_SCHED 1
+
+/*
+ * Fast-forward the timer: when every device has declared itself idle
+ * (next_slot_idle) the time jumps straight to the earliest wake up
+ * slot instead of crawling through the idle slots one by one
+ */
+//#define TIMER_FASTFWD 1
+
+/*
+ * Simulation trace goes to per-thread rings of EVLOG_RING_SZ events
+ * instead of stdout, a writer thread prints it every EVLOG_PERIOD_US
+ * sorted by (time slot, cpu) so the trace of a run is reproducible
+ */
+#define EVLOG 1
+#define EVLOG_RING_SZ 1024
+#define EVLOG_PERIOD_US 200
+
+/*
+ * Number of config entries the loader reads ahead of the time. The
+ * config may be unsorted, but an entry must not come more than
+ * LD_READAHEAD entries after one with a later start time: it would be
+ * read once its start time has passed and admitted late, with a
+ * warning on stderr
+ */
+#define LD_READAHEAD 1024
+
+/* Per process scheduling history, summarised per prio at shutdown */
+//#define SCHED_STATS 1
+
 #define MM_PAGING
 //#define MM_FIXED_MEMSZ
+/* Swap devices are sequential, their seek distance is reported at exit */
+//#define MEMSWP_SEQ 1
+/* Swap devices are sparse files in this directory instead of RAM */
+//#define MEMSWP_FILE "/tmp"
 //#define VMDBG 1
 //#define MMDBG 1
 #define IODUMP 1
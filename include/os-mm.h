@@ -16,6 +16,7 @@
 #define MM_PAGING
 #define PAGING_MAX_MMSWP 4 /* max number of supported swapped space */
 #define PAGING_MAX_SYMTBL_SZ 30
+#define MEMPHY_MAX_ORDER 10 /* largest buddy block, 2^10 frames */
 
 /* 
  * @bksysnet: in long address mode of 64bit or original 32bit
@@ -115,15 +116,26 @@ struct framephy_struct {
 struct memphy_struct {
    /* Basic field of data and size */
    BYTE *storage;
-   int maxsz;
+   addr_t maxsz;
    
    /* Sequential device fields */ 
    int rdmflg;
-   int cursor;
-
-   /* Management structure */
-   struct framephy_struct *free_fp_list;
-   struct framephy_struct *used_fp_list;
+   addr_t cursor;
+   uint64_t nr_seek;    /* Accesses of a sequential device */
+   uint64_t seek_dist;  /* Bytes travelled by the cursor */
+
+   /* Management structure: buddy allocator. A free block of 2^order
+    * frames is linked in fp_head[order] through its first frame, which
+    * records order + 1 in fp_order. Frames from fp_fresh on were never
+    * handed out and are not linked yet */
+   int nr_fp;
+   int fp_fresh;
+   int fp_head[MEMPHY_MAX_ORDER + 1];
+   int *fp_next;
+   int *fp_prev;
+   uint8_t *fp_order;
+   uint32_t *used_fp;  /* Bitmap of the frames handed out */
+   uint32_t *touched_fp; /* Bitmap of the frames written at least once */
 };
 
 #endif
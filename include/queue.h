@@ -4,11 +4,21 @@
 
 #include "common.h"
 
-#define MAX_QUEUE_SIZE 50
-
+/* Initial number of slots, the ring doubles each time it fills up */
+#define QUEUE_INIT_SIZE 8
+
+/*
+ * Growable ring of pcb. A removed entry in the middle of the ring is
+ * left as a NULL hole which is skipped (and reclaimed) later, so that
+ * dequeue and purge never shift the trailing elements.
+ * A zero-filled queue_t is a valid empty queue.
+ */
 struct queue_t {
-	struct pcb_t * proc[MAX_QUEUE_SIZE];
-	int size;
+	struct pcb_t ** proc;
+	int cap;	// Number of allocated slots
+	int head;	// Slot of the oldest entry
+	int used;	// Slots in use from head, holes included
+	int size;	// Number of queued processes
 };
 
 void enqueue(struct queue_t * q, struct pcb_t * proc);
@@ -17,6 +27,9 @@ struct pcb_t * dequeue(struct queue_t * q);
 
 struct pcb_t *purgequeue(struct queue_t *q, struct pcb_t *proc);
 
+/* Return the n-th oldest queued pcb (0 is the head) or NULL */
+struct pcb_t *queue_peek(struct queue_t *q, int n);
+
 int empty(struct queue_t * q);
 
 #endif
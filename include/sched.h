@@ -1,5 +1,5 @@
-#ifndef QUEUE_H
-#define QUEUE_H
+#ifndef SCHED_H
+#define SCHED_H
 
 #include "common.h"
 
@@ -9,20 +9,32 @@
 
 #define MAX_PRIO 140
 
+/* Return 1 if no process is waiting in any ready queue */
 int queue_empty(void);
 
-void init_scheduler(void);
+void init_scheduler(int num_cpus);
 void finish_scheduler(void);
 
-/* Get the next process from ready queue */
-struct pcb_t * get_proc(void);
+/* Get the next process from the ready queue of [cpu] */
+struct pcb_t * get_proc(int cpu);
 
-/* Put a process back to run queue */
-void put_proc(struct pcb_t * proc);
+/* Put a process back to the run queue of [cpu] */
+void put_proc(int cpu, struct pcb_t * proc);
 
-/* Add a new process to ready queue */
+/* Add a new process to the ready queue of the least loaded CPU */
 void add_proc(struct pcb_t * proc);
 
+/* Number of dispatches on another CPU than the previous one */
+unsigned long sched_nr_migrations(void);
+
+#ifdef SCHED_STATS
+/* Keep the scheduling history of a finished process */
+void sched_stat_exit(struct pcb_t * proc);
+
+/* Print turnaround, response and wait percentiles per priority */
+void sched_stat_report(void);
+#endif
+
 #endif
 
 
@@ -4,17 +4,17 @@
 #include <pthread.h>
 #include <stdint.h>
 
+/* Idle with no wake up time of its own */
+#define TIMER_IDLE_FOREVER UINT64_MAX
+
 struct timer_id_t {
-	int done;
+	int sense;	// barrier phase the device is in
 	int fsh;
-	pthread_cond_t event_cond;
-	pthread_mutex_t event_lock;
-	pthread_cond_t timer_cond;
-	pthread_mutex_t timer_lock;
 };
 
 void start_timer();
 
+/* Release the devices, all of them must have been detached */
 void stop_timer();
 
 struct timer_id_t * attach_event();
@@ -23,6 +23,10 @@ void detach_event(struct timer_id_t * event);
 
 void next_slot(struct timer_id_t* timer_id);
 
+/* Same as next_slot but tell the timer that the device has nothing
+ * to do before time slot [until] */
+void next_slot_idle(struct timer_id_t* timer_id, uint64_t until);
+
 uint64_t current_time();
 
 #endif
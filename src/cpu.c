@@ -4,6 +4,8 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include <stdio.h>
+#include <stdlib.h>
 
 int calc(struct pcb_t *proc)
 {
@@ -58,55 +60,257 @@ int write(
 	return write_mem(proc->regs[destination] + offset, proc, data);
 }
 
-int run(struct pcb_t *proc)
+int copy_data(
+	struct pcb_t *proc, // Process executing the instruction
+	uint32_t source,	// Index of source register
+	uint32_t destination, // Index of destination register
+	uint32_t offset,	// Block address = [register] + [offset]
+	uint32_t size)
+{
+	uint32_t i;
+	BYTE data;
+
+	for (i = 0; i < size; i++)
+	{
+		if (read_mem(proc->regs[source] + offset + i, proc, &data) ||
+		    write_mem(proc->regs[destination] + offset + i, proc, data))
+			return 1;
+	}
+	return 0;
+}
+
+int fill_data(
+	struct pcb_t *proc,	// Process executing the instruction
+	BYTE data,		// Data to be wrttien into the whole block
+	uint32_t destination, // Index of destination register
+	uint32_t offset,	// Block address = [destination] + [offset]
+	uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		if (write_mem(proc->regs[destination] + offset + i, proc, data))
+			return 1;
+	}
+	return 0;
+}
+
+int compare_data(
+	struct pcb_t *proc, // Process executing the instruction
+	uint32_t source,	// Index of first register
+	uint32_t destination, // Index of second register
+	uint32_t size,
+	addr_t *result)	// 0 if equal, else 1 + offset of the first difference
+{
+	uint32_t i;
+	BYTE a, b;
+
+	*result = 0;
+	for (i = 0; i < size; i++)
+	{
+		if (read_mem(proc->regs[source] + i, proc, &a) ||
+		    read_mem(proc->regs[destination] + i, proc, &b))
+			return 1;
+		if (a != b)
+		{
+			*result = i + 1;
+			break;
+		}
+	}
+	return 0;
+}
+
+#define NR_REGS (sizeof(((struct pcb_t *)0)->regs) / sizeof(addr_t))
+
+/* Dispatch entries of run_n(), the opcodes plus an invalid one */
+#define OP_INVALID (JNZ + 1)
+
+void code_predecode(struct code_seg_t *code)
+{
+	uint32_t i, ncalc = 0;
+
+	/* One spare entry so an empty program is not a malloc(0) */
+	code->dtext = malloc(sizeof(struct dinst_t) * (code->size + 1));
+	if (code->dtext == NULL)
+	{
+		perror("code_predecode");
+		exit(1);
+	}
+
+	/* Backward, so each CALC knows how many follow it */
+	for (i = code->size; i-- > 0;)
+	{
+		enum ins_opcode_t opcode = code->text[i].opcode;
+
+		ncalc = (opcode == CALC) ? ncalc + 1 : 0;
+		code->dtext[i].op = (opcode <= JNZ) ? opcode : OP_INVALID;
+		code->dtext[i].ncalc = ncalc;
+
+		/* Registers and jump targets are checked once here */
+		if (opcode >= SET && opcode <= JNZ &&
+		    code->text[i].arg_0 >= NR_REGS)
+			code->dtext[i].op = OP_INVALID;
+		if ((opcode == LOOP || opcode == JNZ) &&
+		    code->text[i].arg_1 > code->size)
+			code->dtext[i].op = OP_INVALID;
+		if (opcode == MEMCMP && code->text[i].arg_3 >= NR_REGS)
+			code->dtext[i].op = OP_INVALID;
+	}
+}
+
+int run_n(struct pcb_t *proc, uint32_t budget, uint32_t *nr)
 {
+	static void *dispatch[] = {
+		[CALC] = &&op_calc,
+		[ALLOC] = &&op_alloc,
+		[FREE] = &&op_free,
+		[READ] = &&op_read,
+		[WRITE] = &&op_write,
+		[SYSCALL] = &&op_syscall,
+		[MEMCPY] = &&op_memcpy,
+		[MEMSET] = &&op_memset,
+		[MEMCMP] = &&op_memcmp,
+		[SET] = &&op_set,
+		[LOOP] = &&op_loop,
+		[JNZ] = &&op_jnz,
+		[OP_INVALID] = &&op_invalid,
+	};
+	struct dinst_t *dtext = proc->code->dtext;
+	struct inst_t *ins;
+	uint32_t pc = proc->pc;
+	uint32_t end = proc->code->size;
+	uint32_t left = budget;	// Instructions still allowed, jumps included
+	uint32_t n;
+	int stat = 0;
+
 	/* Check if Program Counter point to the proper instruction */
-	if (proc->pc >= proc->code->size)
+	if (pc >= end)
 	{
+		if (nr != NULL)
+			*nr = 0;
 		return 1;
 	}
 
-	struct inst_t ins = proc->code->text[proc->pc];
-	proc->pc++;
-	int stat = 1;
-switch (ins.opcode)
+#define NEXT()							\
+	do {							\
+		if (stat != 0 || left == 0 || pc >= end)	\
+			goto out;				\
+		left--;						\
+		ins = &proc->code->text[pc];			\
+		goto *dispatch[dtext[pc].op];			\
+	} while (0)
+
+	NEXT();
+
+op_calc:
+	/* CALC only uses the CPU, take the whole run at once */
+	stat = calc(proc);
+	n = dtext[pc].ncalc;
+	if (n > left + 1)
+		n = left + 1;
+	pc += n;
+	left -= n - 1;
+	NEXT();
+op_alloc:
+	pc++;
+#ifdef MM_PAGING
+	stat = liballoc(proc, ins->arg_0, ins->arg_1);
+#else
+	stat = alloc(proc, ins->arg_0, ins->arg_1);
+#endif
+	NEXT();
+op_free:
+	pc++;
+#ifdef MM_PAGING
+	stat = libfree(proc, ins->arg_0);
+#else
+	stat = free_data(proc, ins->arg_0);
+#endif
+	NEXT();
+op_read:
+	pc++;
 	{
-	case CALC:
-		stat = calc(proc);
-		break;
-	case ALLOC:
 #ifdef MM_PAGING
-		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+		uint32_t data = ins->arg_2;
+		stat = libread(proc, ins->arg_0, ins->arg_1, &data);
+#else
+		stat = read(proc, ins->arg_0, ins->arg_1, ins->arg_2);
+#endif
+	}
+	NEXT();
+op_write:
+	pc++;
+#ifdef MM_PAGING
+	stat = libwrite(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #else
-		stat = alloc(proc, ins.arg_0, ins.arg_1);
+	stat = write(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #endif
-		break;
-	case FREE:
+	NEXT();
+op_syscall:
+	pc++;
+	stat = libsyscall(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
+	NEXT();
+op_memcpy:
+	pc++;
 #ifdef MM_PAGING
-		stat = libfree(proc, ins.arg_0);
+	stat = libmemcpy(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
 #else
-		stat = free_data(proc, ins.arg_0);
+	stat = copy_data(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
 #endif
-		break;
-	case READ:
+	NEXT();
+op_memset:
+	pc++;
 #ifdef MM_PAGING
-		stat = libread(proc, ins.arg_0, ins.arg_1, (uint32_t*) &ins.arg_2);
+	stat = libmemset(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
 #else
-		stat = read(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	stat = fill_data(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
 #endif
-		break;
-	case WRITE:
+	NEXT();
+op_memcmp:
+	pc++;
 #ifdef MM_PAGING
-		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	stat = libmemcmp(proc, ins->arg_0, ins->arg_1, ins->arg_2,
+			 &proc->regs[ins->arg_3]);
 #else
-		stat = write(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	stat = compare_data(proc, ins->arg_0, ins->arg_1, ins->arg_2,
+			    &proc->regs[ins->arg_3]);
 #endif
-		break;
-	case SYSCALL:
-		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
-		break;
-	default:
-		stat = 1;
+	NEXT();
+op_set:
+	pc++;
+	proc->regs[ins->arg_0] = ins->arg_1;
+	NEXT();
+op_loop:
+	/* A count already at 0 falls through instead of wrapping around */
+	if (proc->regs[ins->arg_0] > 1) {
+		proc->regs[ins->arg_0]--;
+		pc = ins->arg_1;
+	} else {
+		proc->regs[ins->arg_0] = 0;
+		pc++;
 	}
+	NEXT();
+op_jnz:
+	if (proc->regs[ins->arg_0] != 0)
+		pc = ins->arg_1;
+	else
+		pc++;
+	NEXT();
+op_invalid:
+	pc++;
+	stat = 1;
+	NEXT();
+
+#undef NEXT
+out:
+	if (nr != NULL)
+		*nr = budget - left;
+	proc->pc = pc;
 	return stat;
 }
+
+int run(struct pcb_t *proc)
+{
+	return run_n(proc, 1, NULL);
+}
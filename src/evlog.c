@@ -0,0 +1,239 @@
+
+#include "evlog.h"
+#include "os-cfg.h"
+#include "timer.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static __thread int ev_cpu = EVLOG_NOCPU;
+static __thread uint32_t ev_seq = 0;
+
+static void evlog_format(struct evlog_ev * ev) {
+	switch (ev->kind) {
+	case EV_SLOT:
+		printf("Time slot %3llu\n", (unsigned long long)ev->slot);
+		break;
+	case EV_LD_START:
+		printf("ld_routine\n");
+		break;
+	case EV_LOADED:
+		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
+			ev->str, ev->pid, ev->arg);
+		break;
+	case EV_DISPATCH:
+		printf("\tCPU %d: Dispatched process %2d\n", ev->cpu, ev->pid);
+		break;
+	case EV_PUT:
+		printf("\tCPU %d: Put process %2d to run queue\n",
+			ev->cpu, ev->pid);
+		break;
+	case EV_FINISH:
+		printf("\tCPU %d: Processed %2d has finished\n",
+			ev->cpu, ev->pid);
+		break;
+	case EV_STOP:
+		printf("\tCPU %d stopped\n", ev->cpu);
+		break;
+	case EV_TEXT:
+		fputs(ev->str, stdout);
+		break;
+	}
+	free(ev->str);
+}
+
+#ifdef EVLOG
+
+/* Single producer (owner thread) single consumer (writer) ring */
+struct evlog_buf {
+	struct evlog_ev ev[EVLOG_RING_SZ];
+	unsigned long head;	// next event to read, writer only
+	unsigned long tail;	// next event to write, owner only
+	struct evlog_buf * next;
+};
+
+static __thread struct evlog_buf * ev_buf = NULL;
+
+static struct evlog_buf * buf_list = NULL;
+static pthread_mutex_t buf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t writer;
+static int writer_stop = 0;
+
+/* Events drained from the rings but not printed yet */
+static struct evlog_ev * pending = NULL;
+static size_t nr_pending = 0;
+static size_t pending_cap = 0;
+
+static struct evlog_buf * evlog_buf(void) {
+	if (ev_buf == NULL) {
+		ev_buf = calloc(1, sizeof(struct evlog_buf));
+		if (ev_buf == NULL) {
+			perror("evlog");
+			exit(1);
+		}
+		pthread_mutex_lock(&buf_lock);
+		ev_buf->next = buf_list;
+		__atomic_store_n(&buf_list, ev_buf, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&buf_lock);
+	}
+	return ev_buf;
+}
+
+static void evlog_put(struct evlog_ev * ev) {
+	struct evlog_buf * b = evlog_buf();
+	unsigned long tail = b->tail;
+
+	/* Full ring: wait for the writer to catch up */
+	while (tail - __atomic_load_n(&b->head, __ATOMIC_ACQUIRE) ==
+			EVLOG_RING_SZ)
+		usleep(EVLOG_PERIOD_US);
+
+	b->ev[tail % EVLOG_RING_SZ] = *ev;
+	__atomic_store_n(&b->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void evlog_drain(void) {
+	struct evlog_buf * b;
+
+	for (b = __atomic_load_n(&buf_list, __ATOMIC_ACQUIRE); b != NULL;
+			b = b->next) {
+		unsigned long head = b->head;
+		unsigned long tail = __atomic_load_n(&b->tail, __ATOMIC_ACQUIRE);
+
+		if (tail - head > pending_cap - nr_pending) {
+			while (tail - head > pending_cap - nr_pending)
+				pending_cap = pending_cap ? 2 * pending_cap
+							  : EVLOG_RING_SZ;
+			pending = realloc(pending,
+				pending_cap * sizeof(struct evlog_ev));
+			if (pending == NULL) {
+				perror("evlog");
+				exit(1);
+			}
+		}
+		for (; head != tail; head++)
+			pending[nr_pending++] = b->ev[head % EVLOG_RING_SZ];
+		__atomic_store_n(&b->head, head, __ATOMIC_RELEASE);
+	}
+}
+
+static int evlog_cmp(const void * a, const void * b) {
+	const struct evlog_ev * x = a;
+	const struct evlog_ev * y = b;
+
+	if (x->slot != y->slot)
+		return x->slot < y->slot ? -1 : 1;
+	if (x->cpu != y->cpu)
+		return x->cpu < y->cpu ? -1 : 1;
+	if (x->seq != y->seq)
+		return x->seq < y->seq ? -1 : 1;
+	return 0;
+}
+
+/* Print the pending events of the time slots before [slot] */
+static void evlog_flush(uint64_t slot) {
+	size_t i;
+
+	qsort(pending, nr_pending, sizeof(struct evlog_ev), evlog_cmp);
+	for (i = 0; i < nr_pending && pending[i].slot < slot; i++)
+		evlog_format(&pending[i]);
+	memmove(pending, pending + i, (nr_pending - i) * sizeof(struct evlog_ev));
+	nr_pending -= i;
+}
+
+static void * evlog_writer(void * args) {
+	while (!__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE)) {
+		/* Every event of a slot before the current one has been
+		 * logged already, so take the time before draining */
+		uint64_t slot = current_time();
+		evlog_drain();
+		evlog_flush(slot);
+		usleep(EVLOG_PERIOD_US);
+	}
+	evlog_drain();
+	evlog_flush(UINT64_MAX);
+	return NULL;
+}
+
+void evlog_start(void) {
+	writer_stop = 0;
+	pthread_create(&writer, NULL, evlog_writer, NULL);
+}
+
+void evlog_stop(void) {
+	__atomic_store_n(&writer_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(writer, NULL);
+	fflush(stdout);
+
+	while (buf_list != NULL) {
+		struct evlog_buf * b = buf_list;
+		buf_list = b->next;
+		free(b);
+	}
+	ev_buf = NULL;
+	free(pending);
+	pending = NULL;
+	nr_pending = pending_cap = 0;
+}
+
+#else
+
+static void evlog_put(struct evlog_ev * ev) {
+	evlog_format(ev);
+}
+
+void evlog_start(void) {
+}
+
+void evlog_stop(void) {
+}
+
+#endif
+
+void evlog_thread(int cpu) {
+	ev_cpu = cpu;
+}
+
+static void evlog_add(uint64_t slot, int cpu, int kind, int pid, long arg,
+		char * str) {
+	struct evlog_ev ev = {
+		.slot = slot,
+		.seq = ev_seq++,
+		.cpu = cpu,
+		.pid = pid,
+		.kind = kind,
+		.arg = arg,
+		.str = str,
+	};
+	evlog_put(&ev);
+}
+
+void evlog(int kind, int pid, long arg, const char * str) {
+	evlog_add(current_time(), ev_cpu, kind, pid, arg,
+		str ? strdup(str) : NULL);
+}
+
+void evlog_slot(uint64_t slot) {
+	evlog_add(slot, EVLOG_TIMER, EV_SLOT, 0, 0, NULL);
+}
+
+void evlog_printf(const char * fmt, ...) {
+	va_list ap, aq;
+	char * str;
+	int len;
+
+	va_start(ap, fmt);
+	va_copy(aq, ap);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	str = len < 0 ? NULL : malloc(len + 1);
+	if (str != NULL) {
+		vsnprintf(str, len + 1, fmt, aq);
+		evlog_add(current_time(), ev_cpu, EV_TEXT, 0, 0, str);
+	}
+	va_end(aq);
+	va_end(ap);
+}
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include "lfqueue.h"
+
+int lfq_init(struct lfqueue_t *q, size_t size)
+{
+        size_t cells = 2, i;
+
+        while (cells < size)
+                cells <<= 1;
+
+        q->cell = malloc(sizeof(struct lfq_cell_t) * cells);
+        if (q->cell == NULL)
+                return -1;
+
+        for (i = 0; i < cells; i++) {
+                q->cell[i].seq = i;
+                q->cell[i].proc = NULL;
+        }
+        q->mask = cells - 1;
+        q->enq_pos = 0;
+        q->deq_pos = 0;
+        return 0;
+}
+
+void lfq_destroy(struct lfqueue_t *q)
+{
+        free(q->cell);
+        q->cell = NULL;
+}
+
+int lfq_enqueue(struct lfqueue_t *q, struct pcb_t *proc)
+{
+        struct lfq_cell_t *cell;
+        size_t pos = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED);
+
+        for (;;) {
+                cell = &q->cell[pos & q->mask];
+                size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+                if (dif == 0) {
+                        /* Cell is free at our position, try to claim it */
+                        if (__atomic_compare_exchange_n(&q->enq_pos, &pos, pos + 1,
+                                        1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                                break;
+                } else if (dif < 0) {
+                        return -1; /* Full: the cell still holds an old entry */
+                } else {
+                        pos = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED);
+                }
+        }
+
+        cell->proc = proc;
+        __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+        return 0;
+}
+
+struct pcb_t *lfq_dequeue(struct lfqueue_t *q)
+{
+        struct lfq_cell_t *cell;
+        struct pcb_t *proc;
+        size_t pos = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED);
+
+        for (;;) {
+                cell = &q->cell[pos & q->mask];
+                size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (dif == 0) {
+                        /* Cell holds an entry at our position, try to take it */
+                        if (__atomic_compare_exchange_n(&q->deq_pos, &pos, pos + 1,
+                                        1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                                break;
+                } else if (dif < 0) {
+                        return NULL; /* Empty */
+                } else {
+                        pos = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED);
+                }
+        }
+
+        proc = cell->proc;
+        /* Hand the cell over to the producer one lap later */
+        __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+        return proc;
+}
+
+size_t lfq_size(struct lfqueue_t *q)
+{
+        size_t deq = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED);
+        size_t enq = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED);
+
+        return (enq > deq) ? enq - deq : 0;
+}
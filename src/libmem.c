@@ -19,6 +19,7 @@
 #include "mm64.h"
 #include "syscall.h"
 #include "libmem.h"
+#include "evlog.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -111,7 +112,7 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *allo
 #else
   regs.a3 = PAGING_PAGE_ALIGNSZ(size);
 #endif  
-  syscall(caller->krnl, caller->pid, 17, &regs); /* SYSCALL 17 sys_memmap */
+  krnl_syscall(caller->krnl, caller->pid, 17, &regs); /* SYSCALL 17 sys_memmap */
 
   /*Successful increase limit */
   caller->krnl->mm->symrgtbl[rgid].rg_start = old_sbrk;
@@ -202,7 +203,7 @@ int libfree(struct pcb_t *proc, uint32_t reg_index)
   {
     return -1;
   }
-printf("%s:%d\n",__func__,__LINE__);
+evlog_printf("%s:%d\n",__func__,__LINE__);
 #ifdef IODUMP
   /* TODO dump IO content (if needed) */
 #ifdef PAGETBL_DUMP
@@ -426,6 +427,266 @@ int libwrite(
   return val;
 }
 
+/*get_blkrg - locate a block inside a region
+ *@caller: caller
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@offset: offset of the block in the region
+ *@size: size of the block
+ *@addr: return virtual address of the block
+ *
+ */
+static int get_blkrg(struct pcb_t *caller, int rgid, addr_t offset, addr_t size, addr_t *addr)
+{
+  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+
+  if (currg == NULL || currg->rg_end < currg->rg_start)
+    return -1;
+
+  if (offset > currg->rg_end - currg->rg_start ||
+      size > currg->rg_end - currg->rg_start - offset)
+    return -1; /* Block overflows the region */
+
+  *addr = currg->rg_start + offset;
+  return 0;
+}
+
+/*pg_getblk - get the bytes of a page in ram
+ *@caller: caller
+ *@addr: virtual address to acess
+ *
+ * The page is translated (and swapped in) once, the bytes from addr
+ * to the end of the page are then accessed directly in the storage.
+ */
+static BYTE *pg_getblk(struct pcb_t *caller, addr_t addr)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  int fpn;
+
+  if (pg_getpage(caller->krnl->mm, PAGING_PGN(addr), &fpn, caller) != 0)
+    return NULL;
+
+  if (!mram->rdmflg || (fpn + 1) * PAGING_PAGESZ > mram->maxsz)
+    return NULL;
+
+  /* The block may be written, a read only one reads zeros anyway */
+  MEMPHY_touch(mram, fpn);
+
+  return mram->storage + fpn * PAGING_PAGESZ + PAGING_OFFST(addr);
+}
+
+/*pg_blklen - number of bytes of a block access done in one step
+ *@a: virtual address in the first block
+ *@b: virtual address in the second block
+ *@size: bytes left
+ *
+ * The step stops at the first page boundary of either block.
+ */
+static addr_t pg_blklen(addr_t a, addr_t b, addr_t size)
+{
+  addr_t len = size;
+
+  if (len > PAGING_PAGESZ - PAGING_OFFST(a))
+    len = PAGING_PAGESZ - PAGING_OFFST(a);
+  if (len > PAGING_PAGESZ - PAGING_OFFST(b))
+    len = PAGING_PAGESZ - PAGING_OFFST(b);
+  return len;
+}
+
+/*pg_cpblk - copy bytes inside one page of each side
+ *@caller: caller
+ *@src: virtual address of the source
+ *@dst: virtual address of the destination
+ *@len: number of bytes, no more than pg_blklen()
+ *
+ * Bringing in the destination page may evict the source one, so the
+ * bytes are staged in a page sized buffer.
+ */
+static int pg_cpblk(struct pcb_t *caller, addr_t src, addr_t dst, addr_t len)
+{
+  BYTE buf[PAGING_PAGESZ];
+  BYTE *blk;
+
+  if ((blk = pg_getblk(caller, src)) == NULL)
+    return -1;
+  memcpy(buf, blk, len);
+
+  if ((blk = pg_getblk(caller, dst)) == NULL)
+    return -1;
+  memcpy(blk, buf, len);
+
+  return 0;
+}
+
+/*libmemcpy - PAGING-based copy of a block between regions
+ *@proc: Process executing the instruction
+ *@source: Index of source region
+ *@destination: Index of destination region
+ *@offset: offset of the block in both regions
+ *@size: number of bytes
+ */
+int libmemcpy(
+    struct pcb_t *proc,   // Process executing the instruction
+    uint32_t source,      // Index of source register
+    uint32_t destination, // Index of destination register
+    addr_t offset,        // Block address = [register] + [offset]
+    addr_t size)
+{
+  addr_t src, dst, len;
+  int val = 0;
+
+  pthread_mutex_lock(&mmvm_lock);
+  if (get_blkrg(proc, source, offset, size, &src) != 0 ||
+      get_blkrg(proc, destination, offset, size, &dst) != 0)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  if (dst <= src || dst >= src + size)
+  {
+    while (val == 0 && size > 0)
+    {
+      len = pg_blklen(src, dst, size);
+      val = pg_cpblk(proc, src, dst, len);
+      src += len;
+      dst += len;
+      size -= len;
+    }
+  }
+  else /* Overlapping blocks, copy from the end */
+  {
+    while (val == 0 && size > 0)
+    {
+      /* Complemented, the offsets count down to the page starts */
+      len = pg_blklen(~(src + size - 1), ~(dst + size - 1), size);
+      size -= len;
+      val = pg_cpblk(proc, src + size, dst + size, len);
+    }
+  }
+  pthread_mutex_unlock(&mmvm_lock);
+
+#ifdef IODUMP
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); // print max TBL
+#endif
+  MEMPHY_dump(proc->krnl->mram);
+#endif
+
+  return val;
+}
+
+/*libmemset - PAGING-based fill of a block of a region
+ *@proc: Process executing the instruction
+ *@data: Byte written in the whole block
+ *@destination: Index of destination region
+ *@offset: offset of the block in the region
+ *@size: number of bytes
+ */
+int libmemset(
+    struct pcb_t *proc,   // Process executing the instruction
+    BYTE data,            // Data to be wrttien into memory
+    uint32_t destination, // Index of destination register
+    addr_t offset,        // Block address = [destination] + [offset]
+    addr_t size)
+{
+  addr_t dst, len;
+  BYTE *blk;
+  int val = 0;
+
+  pthread_mutex_lock(&mmvm_lock);
+  if (get_blkrg(proc, destination, offset, size, &dst) != 0)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  while (size > 0)
+  {
+    if ((blk = pg_getblk(proc, dst)) == NULL)
+    {
+      val = -1;
+      break;
+    }
+    len = pg_blklen(dst, dst, size);
+    memset(blk, data, len);
+    dst += len;
+    size -= len;
+  }
+  pthread_mutex_unlock(&mmvm_lock);
+
+#ifdef IODUMP
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); // print max TBL
+#endif
+  MEMPHY_dump(proc->krnl->mram);
+#endif
+
+  return val;
+}
+
+/*libmemcmp - PAGING-based compare of the first bytes of two regions
+ *@proc: Process executing the instruction
+ *@source: Index of the first region
+ *@destination: Index of the second region
+ *@size: number of bytes
+ *@result: 0 if the blocks are equal, else 1 + offset of the first
+ *         differing byte
+ */
+int libmemcmp(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t source,    // Index of first register
+    uint32_t destination, // Index of second register
+    addr_t size,
+    addr_t *result)
+{
+  BYTE buf[PAGING_PAGESZ];
+  addr_t a, b, len, pos = 0;
+  BYTE *blk;
+  int val = 0;
+
+  *result = 0;
+  pthread_mutex_lock(&mmvm_lock);
+  if (get_blkrg(proc, source, 0, size, &a) != 0 ||
+      get_blkrg(proc, destination, 0, size, &b) != 0)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  while (pos < size)
+  {
+    len = pg_blklen(a + pos, b + pos, size - pos);
+    if ((blk = pg_getblk(proc, a + pos)) == NULL)
+    {
+      val = -1;
+      break;
+    }
+    memcpy(buf, blk, len);
+    if ((blk = pg_getblk(proc, b + pos)) == NULL)
+    {
+      val = -1;
+      break;
+    }
+    if (memcmp(buf, blk, len) != 0)
+    {
+      for (len = 0; buf[len] == blk[len]; len++)
+        ;
+      *result = pos + len + 1;
+      break;
+    }
+    pos += len;
+  }
+  pthread_mutex_unlock(&mmvm_lock);
+
+#ifdef IODUMP
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); // print max TBL
+#endif
+#endif
+
+  return val;
+}
+
 /*free_pcb_memphy - collect all memphy of pcb
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -1,17 +1,38 @@
 
 #include "loader.h"
+#include "cpu.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 static uint32_t avail_pid = 1;
 
+/* Programs with running processes, keyed by path */
+struct prog_t {
+	char * path;
+	uint32_t priority;
+	struct code_seg_t * code;
+	struct prog_t * next;
+};
+
+static struct prog_t * prog_cache = NULL;
+static pthread_mutex_t prog_lock = PTHREAD_MUTEX_INITIALIZER;
+
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
 #define OPT_FREE	"free"
 #define OPT_READ	"read"
 #define OPT_WRITE	"write"
 #define OPT_SYSCALL	"syscall"
+#define OPT_MEMCPY	"memcpy"
+#define OPT_MEMSET	"memset"
+#define OPT_MEMCMP	"memcmp"
+#define OPT_SET		"set"
+#define OPT_LOOP	"loop"
+#define OPT_JNZ		"jnz"
 
 static enum ins_opcode_t get_opcode(char * opt) {
 	if (!strcmp(opt, OPT_CALC)) {
@@ -26,71 +47,83 @@ static enum ins_opcode_t get_opcode(char * opt) {
 		return WRITE;
 	}else if (!strcmp(opt, OPT_SYSCALL)) {
 		return SYSCALL;
+	}else if (!strcmp(opt, OPT_MEMCPY)) {
+		return MEMCPY;
+	}else if (!strcmp(opt, OPT_MEMSET)) {
+		return MEMSET;
+	}else if (!strcmp(opt, OPT_MEMCMP)) {
+		return MEMCMP;
+	}else if (!strcmp(opt, OPT_SET)) {
+		return SET;
+	}else if (!strcmp(opt, OPT_LOOP)) {
+		return LOOP;
+	}else if (!strcmp(opt, OPT_JNZ)) {
+		return JNZ;
 	}else{
 		printf("get_opcode return Opcode: %s\n", opt);
 		exit(1);
 	}
 }
 
-struct pcb_t * load(const char * path) {
-	/* Create new PCB for the new process */
-	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
-	proc->page_table =
-		(struct page_table_t*)malloc(sizeof(struct page_table_t));
-	proc->bp = PAGE_SIZE;
-	proc->pc = 0;
-
-	/* Read process code from file */
-	FILE * file;
-	if ((file = fopen(path, "r")) == NULL) {
-		printf("Cannot find process description at '%s'\n", path);
-		exit(1);		
-	}
-	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
+/* Parse a program in the text format */
+static void load_text(FILE * file, struct code_seg_t * code,
+		uint32_t * priority) {
 	char opcode[10];
-	proc->code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
-	fscanf(file, "%u %u", &proc->priority, &proc->code->size);
-	proc->code->text = (struct inst_t*)malloc(
-		sizeof(struct inst_t) * proc->code->size
+	fscanf(file, "%u %u", priority, &code->size);
+	code->text = (struct inst_t*)malloc(
+		sizeof(struct inst_t) * code->size
 	);
 	uint32_t i = 0;
 	char buf[200];
-	for (i = 0; i < proc->code->size; i++) {
+	for (i = 0; i < code->size; i++) {
 		fscanf(file, "%s", opcode);
-		proc->code->text[i].opcode = get_opcode(opcode);
-		switch(proc->code->text[i].opcode) {
+		code->text[i].opcode = get_opcode(opcode);
+		switch(code->text[i].opcode) {
 		case CALC:
 			break;
 		case ALLOC:
+		case SET:
+		case LOOP:
+		case JNZ:
 			fscanf(
 				file,
 				"" FORMAT_ARG " " FORMAT_ARG "\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1
+				&code->text[i].arg_0,
+				&code->text[i].arg_1
 			);
 			break;
 		case FREE:
-			fscanf(file, "" FORMAT_ARG "\n", &proc->code->text[i].arg_0);
+			fscanf(file, "" FORMAT_ARG "\n", &code->text[i].arg_0);
 			break;
 		case READ:
 		case WRITE:
 			fscanf(
 				file,
 				"" FORMAT_ARG " " FORMAT_ARG " " FORMAT_ARG "\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1,
-				&proc->code->text[i].arg_2
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2
 			);
 			break;	
 		case SYSCALL:
 			fgets(buf, sizeof(buf), file);
 			sscanf(buf, "" FORMAT_ARG "" FORMAT_ARG "" FORMAT_ARG "" FORMAT_ARG "",
-			           &proc->code->text[i].arg_0,
-			           &proc->code->text[i].arg_1,
-			           &proc->code->text[i].arg_2,
-			           &proc->code->text[i].arg_3
+			           &code->text[i].arg_0,
+			           &code->text[i].arg_1,
+			           &code->text[i].arg_2,
+			           &code->text[i].arg_3
+			);
+			break;
+		case MEMCPY:
+		case MEMSET:
+		case MEMCMP:
+			fscanf(
+				file,
+				"" FORMAT_ARG " " FORMAT_ARG " " FORMAT_ARG " " FORMAT_ARG "\n",
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2,
+				&code->text[i].arg_3
 			);
 			break;
 		default:
@@ -98,6 +131,168 @@ struct pcb_t * load(const char * path) {
 			exit(1);
 		}
 	}
+}
+
+/* Map [file] as [code] if it is a binary image.
+ * Return 1 if it is not an image, the file is then rewound */
+static int load_image(FILE * file, const char * path,
+		struct code_seg_t * code, uint32_t * priority) {
+	struct img_hdr_t hdr;
+	struct stat st;
+	void * base;
+
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 || hdr.magic != IMG_MAGIC) {
+		rewind(file);
+		return 1;
+	}
+	if (hdr.version != IMG_VERSION ||
+	    hdr.inst_size != sizeof(struct inst_t) ||
+	    fstat(fileno(file), &st) != 0 ||
+	    (uint64_t)st.st_size <
+	    sizeof(hdr) + (uint64_t)hdr.size * sizeof(struct inst_t)) {
+		printf("Bad process image '%s'\n", path);
+		exit(1);
+	}
+
+	/* The mapping outlives the file, text is never written */
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (base == MAP_FAILED) {
+		perror("load_image");
+		exit(1);
+	}
+	*priority = hdr.priority;
+	code->size = hdr.size;
+	code->text = (struct inst_t *)((char *)base + sizeof(hdr));
+	code->map = base;
+	code->map_len = st.st_size;
+	return 0;
+}
+
+static void code_free(struct code_seg_t * code) {
+	if (code->map != NULL)
+		munmap(code->map, code->map_len);
+	else
+		free(code->text);
+	free(code->dtext);
+	free(code);
+}
+
+/* Called with prog_lock held */
+static struct prog_t * prog_find(const char * path) {
+	struct prog_t * prog;
+
+	for (prog = prog_cache; prog != NULL; prog = prog->next)
+		if (!strcmp(prog->path, path))
+			return prog;
+	return NULL;
+}
+
+void code_put(struct code_seg_t * code) {
+	struct prog_t ** link;
+
+	pthread_mutex_lock(&prog_lock);
+	if (--code->ref > 0) {
+		pthread_mutex_unlock(&prog_lock);
+		return;
+	}
+	for (link = &prog_cache; *link != NULL; link = &(*link)->next) {
+		if ((*link)->code == code) {
+			struct prog_t * prog = *link;
+			*link = prog->next;
+			free(prog->path);
+			free(prog);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&prog_lock);
+	code_free(code);
+}
+
+int save_image(struct pcb_t * proc, const char * path) {
+	struct img_hdr_t hdr = {
+		.magic = IMG_MAGIC,
+		.version = IMG_VERSION,
+		.inst_size = sizeof(struct inst_t),
+		.priority = proc->priority,
+		.size = proc->code->size,
+	};
+	FILE * file;
+	int err = 0;
+
+	if ((file = fopen(path, "wb")) == NULL)
+		return -1;
+	if (fwrite(&hdr, sizeof(hdr), 1, file) != 1 ||
+	    fwrite(proc->code->text, sizeof(struct inst_t), hdr.size, file)
+	    != hdr.size)
+		err = -1;
+	if (fclose(file) != 0)
+		err = -1;
+	return err;
+}
+
+struct code_seg_t * load_code(const char * path, uint32_t * priority) {
+	struct code_seg_t * code;
+	struct prog_t * prog;
+
+	/* Share the code of a program that is already loaded */
+	pthread_mutex_lock(&prog_lock);
+	if ((prog = prog_find(path)) != NULL) {
+		code = prog->code;
+		code->ref++;
+		*priority = prog->priority;
+		pthread_mutex_unlock(&prog_lock);
+		return code;
+	}
+	pthread_mutex_unlock(&prog_lock);
+
+	/* Read process code from file */
+	FILE * file;
+	if ((file = fopen(path, "r")) == NULL) {
+		printf("Cannot find process description at '%s'\n", path);
+		exit(1);		
+	}
+	code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
+	code->ref = 1;
+	code->map = NULL;
+	if (load_image(file, path, code, priority) != 0) {
+		load_text(file, code, priority);
+	}
+	fclose(file);
+	code_predecode(code);
+
+	pthread_mutex_lock(&prog_lock);
+	if ((prog = prog_find(path)) != NULL) {
+		/* Somebody loaded it meanwhile, use theirs */
+		code_free(code);
+		prog->code->ref++;
+		code = prog->code;
+	}else{
+		prog = (struct prog_t *)malloc(sizeof(struct prog_t));
+		prog->path = strdup(path);
+		prog->priority = *priority;
+		prog->code = code;
+		prog->next = prog_cache;
+		prog_cache = prog;
+	}
+	pthread_mutex_unlock(&prog_lock);
+	return code;
+}
+
+struct pcb_t * load(const char * path) {
+	/* Create new PCB for the new process */
+	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
+	proc->pid = avail_pid;
+	avail_pid++;
+	proc->page_table =
+		(struct page_table_t*)malloc(sizeof(struct page_table_t));
+	proc->bp = PAGE_SIZE;
+	proc->pc = 0;
+	proc->last_cpu = -1;
+	proc->q_link = NULL;
+	proc->q_idx = -1;
+	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
+
+	proc->code = load_code(path, &proc->priority);
 	return proc;
 }
 
@@ -0,0 +1,25 @@
+/*
+ * Convert a text program of input/proc into a binary process image
+ * that load() maps directly (see struct img_hdr_t)
+ *
+ * Usage: mkimage <text program> <image>
+ */
+
+#include "loader.h"
+#include <stdio.h>
+
+int main(int argc, char * argv[]) {
+	struct pcb_t * proc;
+
+	if (argc != 3) {
+		printf("Usage: mkimage <text program> <image>\n");
+		return 1;
+	}
+
+	proc = load(argv[1]);
+	if (save_image(proc, argv[2]) != 0) {
+		perror(argv[2]);
+		return 1;
+	}
+	return 0;
+}
@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 /*
  *  MEMPHY_mv_csr - move MEMPHY cursor
@@ -26,19 +28,32 @@
  */
 int MEMPHY_mv_csr(struct memphy_struct *mp, addr_t offset)
 {
-   int numstep = 0;
+   addr_t target = (offset < mp->maxsz) ? offset : 0;
 
-   mp->cursor = 0;
-   while (numstep < offset && numstep < mp->maxsz)
-   {
-      /* Traverse sequentially */
-      mp->cursor = (mp->cursor + 1) % mp->maxsz;
-      numstep++;
-   }
+   /* Jump to the target, the traversal is only accounted as a seek */
+   mp->nr_seek++;
+   mp->seek_dist += (target > mp->cursor) ? target - mp->cursor
+                                          : mp->cursor - target;
+   mp->cursor = target;
 
    return 0;
 }
 
+/* Frames never written read as zero, their storage is left alone */
+#define FP_TOUCHED(mp, addr) \
+   ((mp)->touched_fp[(addr) / PAGING_PAGESZ / 32] & \
+    (1U << ((addr) / PAGING_PAGESZ % 32)))
+
+/*
+ *  MEMPHY_touch - mark a frame as written
+ *  @mp: memphy struct
+ *  @fpn: frame page number
+ */
+void MEMPHY_touch(struct memphy_struct *mp, addr_t fpn)
+{
+   mp->touched_fp[fpn / 32] |= 1U << (fpn % 32);
+}
+
 /*
  *  MEMPHY_seq_read - read MEMPHY device
  *  @mp: memphy struct
@@ -50,11 +65,11 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
+   if (mp->rdmflg)
       return -1; /* Not compatible mode for sequential read */
 
    MEMPHY_mv_csr(mp, addr);
-   *value = (BYTE)mp->storage[addr];
+   *value = FP_TOUCHED(mp, addr) ? (BYTE)mp->storage[addr] : 0;
 
    return 0;
 }
@@ -71,7 +86,7 @@ int MEMPHY_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
       return -1;
 
    if (mp->rdmflg)
-      *value = mp->storage[addr];
+      *value = FP_TOUCHED(mp, addr) ? mp->storage[addr] : 0;
    else /* Sequential access device */
       return MEMPHY_seq_read(mp, addr, value);
 
@@ -90,10 +105,11 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
+   if (mp->rdmflg)
       return -1; /* Not compatible mode for sequential read */
 
    MEMPHY_mv_csr(mp, addr);
+   MEMPHY_touch(mp, addr / PAGING_PAGESZ);
    mp->storage[addr] = value;
 
    return 0;
@@ -111,13 +127,39 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
       return -1;
 
    if (mp->rdmflg)
+   {
+      MEMPHY_touch(mp, addr / PAGING_PAGESZ);
       mp->storage[addr] = data;
+   }
    else /* Sequential access device */
       return MEMPHY_seq_write(mp, addr, data);
 
    return 0;
 }
 
+/* Add the free block of 2^order frames at fpn to its list */
+static void fp_link(struct memphy_struct *mp, int fpn, int order)
+{
+   mp->fp_order[fpn] = order + 1;
+   mp->fp_prev[fpn] = -1;
+   mp->fp_next[fpn] = mp->fp_head[order];
+   if (mp->fp_head[order] >= 0)
+      mp->fp_prev[mp->fp_head[order]] = fpn;
+   mp->fp_head[order] = fpn;
+}
+
+/* Remove the free block at fpn from its list */
+static void fp_unlink(struct memphy_struct *mp, int fpn, int order)
+{
+   if (mp->fp_prev[fpn] >= 0)
+      mp->fp_next[mp->fp_prev[fpn]] = mp->fp_next[fpn];
+   else
+      mp->fp_head[order] = mp->fp_next[fpn];
+   if (mp->fp_next[fpn] >= 0)
+      mp->fp_prev[mp->fp_next[fpn]] = mp->fp_prev[fpn];
+   mp->fp_order[fpn] = 0;
+}
+
 /*
  *  MEMPHY_format-format MEMPHY device
  *  @mp: memphy struct
@@ -126,48 +168,131 @@ int MEMPHY_format(struct memphy_struct *mp, int pagesz)
 {
    /* This setting come with fixed constant PAGESZ */
    int numfp = mp->maxsz / pagesz;
-   struct framephy_struct *newfst, *fst;
-   int iter = 0;
+   int order;
+
+   mp->nr_fp = 0;
+   mp->fp_fresh = 0;
+   for (order = 0; order <= MEMPHY_MAX_ORDER; order++)
+      mp->fp_head[order] = -1;
 
    if (numfp <= 0)
       return -1;
 
-   /* Init head of free framephy list */
-   fst = malloc(sizeof(struct framephy_struct));
-   fst->fpn = iter;
-   mp->free_fp_list = fst;
+   mp->fp_next = malloc(numfp * sizeof(int));
+   mp->fp_prev = malloc(numfp * sizeof(int));
+   mp->fp_order = calloc(numfp, sizeof(uint8_t));
+   mp->used_fp = calloc((numfp + 31) / 32, sizeof(uint32_t));
+   if (mp->fp_next == NULL || mp->fp_prev == NULL ||
+       mp->fp_order == NULL || mp->used_fp == NULL)
+      return -1;
+   mp->nr_fp = numfp;
+
+   /* Blocks are linked by fp_carve() on demand, so the metadata of a
+    * large device is not touched before its frames are */
+   return 0;
+}
+
+/* Link the next largest aligned block of never used frames.
+ * Return 0 once the device is used up */
+static int fp_carve(struct memphy_struct *mp)
+{
+   int fpn = mp->fp_fresh;
+   int order = MEMPHY_MAX_ORDER;
+
+   if (fpn >= mp->nr_fp)
+      return 0;
+   while ((fpn & ((1 << order) - 1)) || fpn + (1 << order) > mp->nr_fp)
+      order--;
+   fp_link(mp, fpn, order);
+   mp->fp_fresh += 1 << order;
+
+   return 1;
+}
+
+#define FP_USED(mp, fpn) ((mp)->used_fp[(fpn) / 32] & (1U << ((fpn) % 32)))
+
+/*
+ *  MEMPHY_get_freerun - take 2^order contiguous free frames
+ *  @mp: memphy struct
+ *  @order: log2 of the number of frames
+ *  @retfpn: first frame of the run, aligned to its size
+ */
+int MEMPHY_get_freerun(struct memphy_struct *mp, int order, addr_t *retfpn)
+{
+   int o, fpn, i;
+
+   if (order < 0 || order > MEMPHY_MAX_ORDER)
+      return -1;
+   for (;;)
+   {
+      for (o = order; o <= MEMPHY_MAX_ORDER && mp->fp_head[o] < 0; o++)
+         ;
+      if (o <= MEMPHY_MAX_ORDER)
+         break;
+      if (!fp_carve(mp))
+         return -1;
+   }
+
+   fpn = mp->fp_head[o];
+   fp_unlink(mp, fpn, o);
 
-   /* We have list with first element, fill in the rest num-1 element member*/
-   for (iter = 1; iter < numfp; iter++)
+   /* Split down, the upper halves go back to the free lists */
+   while (o > order)
    {
-      newfst = malloc(sizeof(struct framephy_struct));
-      newfst->fpn = iter;
-      newfst->fp_next = NULL;
-      fst->fp_next = newfst;
-      fst = newfst;
+      o--;
+      fp_link(mp, fpn + (1 << o), o);
    }
 
+   for (i = fpn; i < fpn + (1 << order); i++)
+      mp->used_fp[i / 32] |= 1U << (i % 32);
+   *retfpn = fpn;
+
    return 0;
 }
 
-int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
+/*
+ *  MEMPHY_put_freerun - release 2^order contiguous frames
+ *  @mp: memphy struct
+ *  @fpn: first frame of the run
+ *  @order: log2 of the number of frames
+ *
+ *  The frames need not come from one MEMPHY_get_freerun(), the blocks
+ *  are merged with their free buddies anyway.
+ */
+int MEMPHY_put_freerun(struct memphy_struct *mp, addr_t fpn, int order)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
+   addr_t i, buddy;
 
-   if (fp == NULL)
+   if (order < 0 || order > MEMPHY_MAX_ORDER ||
+       (fpn & ((1 << order) - 1)) || fpn + (1 << order) > mp->nr_fp)
       return -1;
 
-   *retfpn = fp->fpn;
-   mp->free_fp_list = fp->fp_next;
+   /* Frames not handed out (or already released) are rejected */
+   for (i = fpn; i < fpn + (1 << order); i++)
+      if (!FP_USED(mp, i))
+         return -1;
+   for (i = fpn; i < fpn + (1 << order); i++)
+      mp->used_fp[i / 32] &= ~(1U << (i % 32));
 
-   /* MEMPHY is iteratively used up until its exhausted
-    * No garbage collector acting then it not been released
-    */
-   free(fp);
+   while (order < MEMPHY_MAX_ORDER)
+   {
+      buddy = fpn ^ (1 << order);
+      if (buddy >= mp->nr_fp || mp->fp_order[buddy] != order + 1)
+         break;
+      fp_unlink(mp, buddy, order);
+      fpn &= ~(addr_t)(1 << order);
+      order++;
+   }
+   fp_link(mp, fpn, order);
 
    return 0;
 }
 
+int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
+{
+   return MEMPHY_get_freerun(mp, 0, retfpn);
+}
+
 int MEMPHY_dump(struct memphy_struct *mp)
 {
   /*TODO dump memphy contnt mp->storage
@@ -178,13 +303,25 @@ int MEMPHY_dump(struct memphy_struct *mp)
 
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
-   struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
+   return MEMPHY_put_freerun(mp, fpn, 0);
+}
+
+/* Init the fields of a MEMPHY struct but its storage */
+static int memphy_setup(struct memphy_struct *mp, addr_t max_size, int randomflg)
+{
+   mp->maxsz = max_size;
+   mp->touched_fp = calloc(max_size / PAGING_PAGESZ / 32 + 1, sizeof(uint32_t));
+   if (mp->touched_fp == NULL)
+      return -1;
 
-   /* Create new node with value fpn */
-   newnode->fpn = fpn;
-   newnode->fp_next = fp;
-   mp->free_fp_list = newnode;
+   MEMPHY_format(mp, PAGING_PAGESZ);
+
+   mp->rdmflg = (randomflg != 0) ? 1 : 0;
+
+   if (!mp->rdmflg) /* Not Ramdom acess device, then it serial device*/
+      mp->cursor = 0;
+   mp->nr_seek = 0;
+   mp->seek_dist = 0;
 
    return 0;
 }
@@ -194,18 +331,52 @@ int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
  */
 int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
 {
-   mp->storage = (BYTE *)malloc(max_size * sizeof(BYTE));
-   mp->maxsz = max_size;
-   memset(mp->storage, 0, max_size * sizeof(BYTE));
+   size_t len = (max_size > 0) ? max_size : 1;
+
+   /* Demand zero: the host only backs the pages written */
+   mp->storage = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (mp->storage == MAP_FAILED)
+      mp->storage = (BYTE *)calloc(len, sizeof(BYTE));
+   if (mp->storage == NULL)
+      return -1;
 
-   MEMPHY_format(mp, PAGING_PAGESZ);
+   return memphy_setup(mp, max_size, randomflg);
+}
 
-   mp->rdmflg = (randomflg != 0) ? 1 : 0;
+/*
+ *  Init MEMPHY struct backed by a sparse file in dir
+ *
+ *  The file is unlinked once created and its shared mapping is the
+ *  storage, so only the pages touched take memory or disk.
+ */
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size, int randomflg,
+                     const char *dir)
+{
+   char path[4096];
+   int fd;
 
-   if (!mp->rdmflg) /* Not Ramdom acess device, then it serial device*/
-      mp->cursor = 0;
+   snprintf(path, sizeof(path), "%s/memphyXXXXXX", dir);
+   if ((fd = mkstemp(path)) < 0)
+      return -1;
+   unlink(path);
 
-   return 0;
+   mp->storage = NULL;
+   if (max_size > 0)
+   {
+      if (ftruncate(fd, max_size) != 0)
+      {
+         close(fd);
+         return -1;
+      }
+      mp->storage = mmap(NULL, max_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_NORESERVE, fd, 0);
+   }
+   close(fd);
+   if (mp->storage == MAP_FAILED)
+      return -1;
+
+   return memphy_setup(mp, max_size, randomflg);
 }
 
 // #endif
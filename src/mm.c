@@ -14,6 +14,7 @@
   */
  
 #include "mm.h"
+#include "evlog.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -71,7 +72,7 @@ int init_pte(addr_t *pte,
  */
 int get_pd_from_address(addr_t addr, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -86,7 +87,7 @@ int get_pd_from_address(addr_t addr, addr_t* pgd, addr_t* p4d, addr_t* pud, addr
  */
 int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -136,7 +137,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
  **/
 uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -160,7 +161,7 @@ int vmap_pgd_memset(struct pcb_t *caller,           // process call
                     addr_t addr,                       // start address which is aligned to pagesz
                     int pgnum)                      // num of mapping page
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -173,7 +174,7 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
                     struct framephy_struct *frames, // list of the mapped frames
                     struct vm_rg_struct *ret_rg)    // return mapped region, the real mapped fp
 {                                                   // no guarantee all given pages are mapped
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -186,7 +187,7 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
 
 addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -201,7 +202,7 @@ addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_st
  */
 addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapstart, int incpgnum, struct vm_rg_struct *ret_rg)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -214,7 +215,7 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -225,55 +226,55 @@ int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
  */
 int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct *rgnode)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int enlist_pgn_node(struct pgn_t **plist, addr_t pgn)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int print_list_fp(struct framephy_struct *ifp)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int print_list_rg(struct vm_rg_struct *irg)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int print_list_vma(struct vm_area_struct *ivma)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int print_list_pgn(struct pgn_t *ip)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
 int print_pgtbl(struct pcb_t *caller, uint32_t start, uint32_t end)
 {
-  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  evlog_printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
 
@@ -285,8 +285,8 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
 
 addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
 {
-  addr_t fpn;
-  int pgit;
+  addr_t fpn, run;
+  int pgit, order = 0, contig;
   struct framephy_struct *newfp_str = NULL;
   struct framephy_struct *head = NULL;
   struct framephy_struct *tail = NULL;
@@ -296,10 +296,20 @@ addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_st
   //frm_lst-> ...
   */
 
+  /* Contiguous frames if a buddy block is large enough, the frames
+   * past req_pgnum are given back right away */
+  while ((1 << order) < req_pgnum)
+    order++;
+  contig = MEMPHY_get_freerun(caller->krnl->mram, order, &run) == 0;
+  for (pgit = req_pgnum; contig && pgit < (1 << order); pgit++)
+    MEMPHY_put_freefp(caller->krnl->mram, run + pgit);
+
   for (pgit = 0; pgit < req_pgnum; pgit++)
   {
-    /* Try to get a free frame from MEMRAM */
-        if (MEMPHY_get_freefp(caller->krnl->mram, &fpn) == 0)
+    /* Frame of the run, else a free frame from MEMRAM */
+        if (contig)
+            fpn = run + pgit;
+        if (contig || MEMPHY_get_freefp(caller->krnl->mram, &fpn) == 0)
         {
             /* Allocate node for this frame */
             newfp_str = (struct framephy_struct *)malloc(sizeof(struct framephy_struct));
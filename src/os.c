@@ -1,6 +1,7 @@
 
 #include "cpu.h"
 #include "timer.h"
+#include "evlog.h"
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
@@ -9,15 +10,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static int time_slot;
 static int num_cpus;
+static int ipc = 1;	// Instructions run by a CPU in each time slot
 static int done = 0;
 static struct krnl_t os;
 
 #ifdef MM_PAGING
-static int memramsz;
-static int memswpsz[PAGING_MAX_MMSWP];
+static unsigned long memramsz;
+static unsigned long memswpsz[PAGING_MAX_MMSWP];
 
 struct mmpaging_ld_args {
 	/* A dispatched argument struct to compact many-fields passing to loader */
@@ -30,70 +33,106 @@ struct mmpaging_ld_args {
 };
 #endif
 
-static struct ld_args{
-	char ** path;
-	unsigned long * start_time;
-#ifdef MLQ_SCHED
-	unsigned long * prio;
-#endif
-} ld_processes;
+/* Process list of the config file, read on demand by arrival_fill() */
+static FILE * config_file;
+static int nr_read = 0;
 int num_processes;
 
+/* A program read by the preload pool ahead of its admission */
+struct preload_t {
+	const char * path;
+	struct code_seg_t * code;	// Reference taken by the pool, NULL until read
+	struct preload_t * next;	// Next job waiting for the pool
+};
+
+/* A process of the config waiting for its start time */
+struct arrival_t {
+	unsigned long start_time;
+	unsigned long prio;
+	int seq;			// Position in the config, breaks ties
+	char * path;
+	struct preload_t * pl;		// Preload job of the program
+};
+
+/* Jobs of the preload pool in config order, protected by preload_lock */
+static pthread_mutex_t preload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t preload_job = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t preload_done = PTHREAD_COND_INITIALIZER;
+static struct preload_t * preload_head = NULL;
+static struct preload_t ** preload_tail = &preload_head;
+static int preload_quit = 0;
+static pthread_t * preload_pool;
+static long preload_nthreads;
+
 struct cpu_args {
 	struct timer_id_t * timer_id;
 	int id;
 };
 
 
+/* An idle CPU can only be woken up by queued work, let the
+ * timer skip ahead if nothing is waiting */
+static void idle_slot(struct timer_id_t * timer_id) {
+	if (queue_empty())
+		next_slot_idle(timer_id, TIMER_IDLE_FOREVER);
+	else
+		next_slot(timer_id);
+}
+
 static void * cpu_routine(void * args) {
 	struct timer_id_t * timer_id = ((struct cpu_args*)args)->timer_id;
 	int id = ((struct cpu_args*)args)->id;
 	/* Check for new process in ready queue */
 	int time_left = 0;
 	struct pcb_t * proc = NULL;
+	evlog_thread(id);
 	while (1) {
 		/* Check the status of current process */
 		if (proc == NULL) {
 			/* No process is running, the we load new process from
 		 	* ready queue */
-			proc = get_proc();
-			if (proc == NULL) {
-                           next_slot(timer_id);
+			proc = get_proc(id);
+			if (proc == NULL && !done) {
+                           idle_slot(timer_id);
                            continue; /* First load failed. skip dummy load */
                         }
 		}else if (proc->pc == proc->code->size) {
 			/* The porcess has finish it job */
-			printf("\tCPU %d: Processed %2d has finished\n",
-				id ,proc->pid);
+			evlog(EV_FINISH, proc->pid, 0, NULL);
+#ifdef SCHED_STATS
+			sched_stat_exit(proc);
+#endif
+			code_put(proc->code);
 			free(proc);
-			proc = get_proc();
+			proc = get_proc(id);
 			time_left = 0;
 		}else if (time_left == 0) {
 			/* The process has done its job in current time slot */
-			printf("\tCPU %d: Put process %2d to run queue\n",
-				id, proc->pid);
-			put_proc(proc);
-			proc = get_proc();
+			evlog(EV_PUT, proc->pid, 0, NULL);
+			put_proc(id, proc);
+			proc = get_proc(id);
 		}
 		
 		/* Recheck process status after loading new process */
-		if (proc == NULL && done) {
+		if (proc == NULL && done && queue_empty()) {
 			/* No process to run, exit */
-			printf("\tCPU %d stopped\n", id);
+			evlog(EV_STOP, 0, 0, NULL);
 			break;
 		}else if (proc == NULL) {
 			/* There may be new processes to run in
 			 * next time slots, just skip current slot */
-			next_slot(timer_id);
+			idle_slot(timer_id);
 			continue;
 		}else if (time_left == 0) {
-			printf("\tCPU %d: Dispatched process %2d\n",
-				id, proc->pid);
+			evlog(EV_DISPATCH, proc->pid, 0, NULL);
 			time_left = time_slot;
 		}
 		
 		/* Run current process */
-		run(proc);
+		run_n(proc, ipc, NULL);
+#ifdef SCHED_STATS
+		proc->run_slots++;
+#endif
 		time_left--;
 		next_slot(timer_id);
 	}
@@ -101,6 +140,149 @@ static void * cpu_routine(void * args) {
 	pthread_exit(NULL);
 }
 
+/* Pending arrivals: min-heap on (start_time, seq) holding a window
+ * of at most LD_READAHEAD entries of the config */
+static struct arrival_t arrivals[LD_READAHEAD];
+static int nr_arrivals = 0;
+
+static int arrival_before(struct arrival_t * a, struct arrival_t * b) {
+	if (a->start_time != b->start_time)
+		return a->start_time < b->start_time;
+	return a->seq < b->seq;
+}
+
+static void arrival_push(struct arrival_t * a) {
+	int pos = nr_arrivals++;
+
+	while (pos > 0 && arrival_before(a, &arrivals[(pos - 1) / 2])) {
+		arrivals[pos] = arrivals[(pos - 1) / 2];
+		pos = (pos - 1) / 2;
+	}
+	arrivals[pos] = *a;
+}
+
+static struct arrival_t arrival_pop(void) {
+	struct arrival_t top = arrivals[0];
+	struct arrival_t last = arrivals[--nr_arrivals];
+	int pos = 0, child;
+
+	while ((child = 2 * pos + 1) < nr_arrivals) {
+		if (child + 1 < nr_arrivals &&
+		    arrival_before(&arrivals[child + 1], &arrivals[child]))
+			child++;
+		if (!arrival_before(&arrivals[child], &last))
+			break;
+		arrivals[pos] = arrivals[child];
+		pos = child;
+	}
+	arrivals[pos] = last;
+	return top;
+}
+
+static void * preload_routine(void * args) {
+	struct preload_t * pl;
+	struct code_seg_t * code;
+	uint32_t priority;
+
+	pthread_mutex_lock(&preload_lock);
+	for (;;) {
+		while (preload_head == NULL && !preload_quit)
+			pthread_cond_wait(&preload_job, &preload_lock);
+		if ((pl = preload_head) == NULL)
+			break;
+		if ((preload_head = pl->next) == NULL)
+			preload_tail = &preload_head;
+		pthread_mutex_unlock(&preload_lock);
+
+		code = load_code(pl->path, &priority);
+
+		pthread_mutex_lock(&preload_lock);
+		pl->code = code;
+		pthread_cond_broadcast(&preload_done);
+	}
+	pthread_mutex_unlock(&preload_lock);
+	return NULL;
+}
+
+/* Hand the program at [path] to the preload pool */
+static struct preload_t * preload_submit(const char * path) {
+	struct preload_t * pl = (struct preload_t *)malloc(sizeof(struct preload_t));
+
+	pl->path = path;
+	pl->code = NULL;
+	pl->next = NULL;
+	pthread_mutex_lock(&preload_lock);
+	*preload_tail = pl;
+	preload_tail = &pl->next;
+	pthread_cond_signal(&preload_job);
+	pthread_mutex_unlock(&preload_lock);
+	return pl;
+}
+
+/* Wait for the job [pl] and return the reference it took. The pool
+ * works ahead of the time, so this normally does not wait */
+static struct code_seg_t * preload_wait(struct preload_t * pl) {
+	struct code_seg_t * code;
+
+	pthread_mutex_lock(&preload_lock);
+	while (pl->code == NULL)
+		pthread_cond_wait(&preload_done, &preload_lock);
+	code = pl->code;
+	pthread_mutex_unlock(&preload_lock);
+	free(pl);
+	return code;
+}
+
+/* Read the next process of the config. Return 0 on success, -1 once
+ * the M processes announced by the config (or the file) are read */
+static int arrival_read(struct arrival_t * a) {
+	static char * line = NULL;
+	static size_t cap = 0;
+	char * name;
+	int n;
+
+	while (nr_read < num_processes && getline(&line, &cap, config_file) > 0) {
+		a->prio = 0;
+		n = sscanf(line, "%lu %ms %lu", &a->start_time, &name, &a->prio);
+		if (n < 2)
+			continue;	/* blank line */
+#ifdef MLQ_SCHED
+		if (n < 3) {
+			printf("Missing priority of process %s\n", name);
+			exit(1);
+		}
+#endif
+		a->path = (char *)malloc(strlen("input/proc/") + strlen(name) + 1);
+		sprintf(a->path, "input/proc/%s", name);
+		free(name);
+		a->seq = nr_read++;
+		a->pl = NULL;
+		return 0;
+	}
+	free(line);
+	line = NULL;
+	cap = 0;
+	return -1;
+}
+
+/* Read ahead the config until the window of arrivals is full, and
+ * send each new entry to the preload pool. An entry read after its
+ * start time is admitted late, warn about it */
+static void arrival_fill(void) {
+	struct arrival_t a;
+	uint64_t now = current_time();
+
+	while (nr_arrivals < LD_READAHEAD && arrival_read(&a) == 0) {
+		if (a.start_time < now)
+			fprintf(stderr, "Config entry %d (%s) due at time %lu is "
+				"admitted late at time %lu, the config is out of "
+				"order by more than LD_READAHEAD entries\n",
+				a.seq, a.path, a.start_time, (unsigned long)now);
+		a.pl = preload_submit(a.path);
+		arrival_push(&a);
+	}
+}
+
 static void * ld_routine(void * args) {
 #ifdef MM_PAGING
 	struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
@@ -110,34 +292,41 @@ static void * ld_routine(void * args) {
 #else
 	struct timer_id_t * timer_id = (struct timer_id_t*)args;
 #endif
-	int i = 0;
-	printf("ld_routine\n");
-	while (i < num_processes) {
-		struct pcb_t * proc = load(ld_processes.path[i]);
-		struct krnl_t * krnl = proc->krnl = &os;	
+	evlog(EV_LD_START, 0, 0, NULL);
+	for (arrival_fill(); nr_arrivals > 0; arrival_fill()) {
+		uint64_t now = current_time();
+		if (now < arrivals[0].start_time) {
+			next_slot_idle(timer_id, arrivals[0].start_time);
+			continue;
+		}
+
+		/* Admit every process due by now in one slot */
+		while (nr_arrivals > 0 && arrivals[0].start_time <= now) {
+			struct arrival_t a = arrival_pop();
+			struct code_seg_t * code = preload_wait(a.pl);
+			struct pcb_t * proc = load(a.path);
+			struct krnl_t * krnl = proc->krnl = &os;	
 
+			code_put(code);
 #ifdef MLQ_SCHED
-		proc->prio = ld_processes.prio[i];
+			proc->prio = a.prio;
 #endif
-		while (current_time() < ld_processes.start_time[i]) {
-			next_slot(timer_id);
-		}
 #ifdef MM_PAGING
-		krnl->mm = malloc(sizeof(struct mm_struct));
-		init_mm(krnl->mm, proc);
-		krnl->mram = mram;
-		krnl->mswp = mswp;
-		krnl->active_mswp = active_mswp;
+			krnl->mm = malloc(sizeof(struct mm_struct));
+			init_mm(krnl->mm, proc);
+			krnl->mram = mram;
+			krnl->mswp = mswp;
+			krnl->active_mswp = active_mswp;
 #endif
-		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
-			ld_processes.path[i], proc->pid, ld_processes.prio[i]);
-		add_proc(proc);
-		free(ld_processes.path[i]);
-		i++;
+			evlog(EV_LOADED, proc->pid, a.prio, a.path);
+			add_proc(proc);
+			free(a.path);
+			/* More than a window may be due in this slot */
+			arrival_fill();
+		}
 		next_slot(timer_id);
 	}
-	free(ld_processes.path);
-	free(ld_processes.start_time);
+	fclose(config_file);
 	done = 1;
 	detach_event(timer_id);
 	pthread_exit(NULL);
@@ -149,10 +338,17 @@ static void read_config(const char * path) {
 		printf("Cannot find configure file at %s\n", path);
 		exit(1);
 	}
-	fscanf(file, "%d %d %d\n", &time_slot, &num_cpus, &num_processes);
-	ld_processes.path = (char**)malloc(sizeof(char*) * num_processes);
-	ld_processes.start_time = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
+	/* [time slice] [N = Number of CPU] [M = Number of Processes to be run]
+	 * and optionally [K = Instructions per time slot], 1 by default */
+	char line[100];
+	if (fgets(line, sizeof(line), file) == NULL ||
+	    sscanf(line, "%d %d %d %d", &time_slot, &num_cpus,
+			&num_processes, &ipc) < 3) {
+		printf("Bad configure file %s\n", path);
+		exit(1);
+	}
+	if (ipc < 1)
+		ipc = 1;
 #ifdef MM_PAGING
 	int sit;
 #ifdef MM_FIXED_MEMSZ
@@ -170,31 +366,60 @@ static void read_config(const char * path) {
 	 * Format: (size=0 result non-used memswap, must have RAM and at least 1 SWAP)
 	 *        MEM_RAM_SZ MEM_SWP0_SZ MEM_SWP1_SZ MEM_SWP2_SZ MEM_SWP3_SZ
 	*/
-	fscanf(file, "%d\n", &memramsz);
+	fscanf(file, "%lu\n", &memramsz);
 	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
-		fscanf(file, "%d", &(memswpsz[sit])); 
+		fscanf(file, "%lu", &(memswpsz[sit])); 
 
        fscanf(file, "\n"); /* Final character */
+
+	/* Devices are sized in addr_t, 4 GiB and more need MM64 */
+	if (memramsz > (addr_t)-1) {
+		printf("MEMRAM size %lu too large for addr_t\n", memramsz);
+		exit(1);
+	}
+	for (sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+		if (memswpsz[sit] > (addr_t)-1) {
+			printf("MEMSWP %d size %lu too large for addr_t\n",
+				sit, memswpsz[sit]);
+			exit(1);
+		}
+	}
 #endif
 #endif
 
-#ifdef MLQ_SCHED
-	ld_processes.prio = (unsigned long*)
-		malloc(sizeof(unsigned long) * num_processes);
-#endif
+	/* The process list is streamed by the loader */
+	config_file = file;
+}
+
+/* Start the pool of host threads reading the programs of the config
+ * ahead of their admission, so the loads done by ld_routine in
+ * simulated time do not touch the disk. It is fed by arrival_fill()
+ * as the window moves and the references are dropped at admission */
+static void preload_start(void) {
 	int i;
-	for (i = 0; i < num_processes; i++) {
-		ld_processes.path[i] = (char*)malloc(sizeof(char) * 100);
-		ld_processes.path[i][0] = '\0';
-		strcat(ld_processes.path[i], "input/proc/");
-		char proc[100];
-#ifdef MLQ_SCHED
-		fscanf(file, "%lu %s %lu\n", &ld_processes.start_time[i], proc, &ld_processes.prio[i]);
-#else
-		fscanf(file, "%lu %s\n", &ld_processes.start_time[i], proc);
-#endif
-		strcat(ld_processes.path[i], proc);
-	}
+
+	preload_nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (preload_nthreads > num_processes)
+		preload_nthreads = num_processes;
+	if (preload_nthreads < 1)
+		preload_nthreads = 1;
+	preload_pool = (pthread_t *)malloc(sizeof(pthread_t) * preload_nthreads);
+	for (i = 0; i < preload_nthreads; i++)
+		pthread_create(&preload_pool[i], NULL, preload_routine, NULL);
+	arrival_fill();
+}
+
+/* Every job was waited for at admission, the pool is idle */
+static void preload_stop(void) {
+	int i;
+
+	pthread_mutex_lock(&preload_lock);
+	preload_quit = 1;
+	pthread_cond_broadcast(&preload_job);
+	pthread_mutex_unlock(&preload_lock);
+	for (i = 0; i < preload_nthreads; i++)
+		pthread_join(preload_pool[i], NULL);
+	free(preload_pool);
 }
 
 int main(int argc, char * argv[]) {
@@ -203,11 +428,11 @@ int main(int argc, char * argv[]) {
 		printf("Usage: os [path to configure file]\n");
 		return 1;
 	}
-	char path[100];
-	path[0] = '\0';
-	strcat(path, "input/");
-	strcat(path, argv[1]);
+	char * path = (char *)malloc(strlen("input/") + strlen(argv[1]) + 1);
+	sprintf(path, "input/%s", argv[1]);
 	read_config(path);
+	free(path);
+	preload_start();
 
 	pthread_t * cpu = (pthread_t*)malloc(num_cpus * sizeof(pthread_t));
 	struct cpu_args * args =
@@ -221,6 +446,7 @@ int main(int argc, char * argv[]) {
 		args[i].id = i;
 	}
 	struct timer_id_t * ld_event = attach_event();
+	evlog_start();
 	start_timer();
 
 #ifdef MM_PAGING
@@ -235,8 +461,20 @@ int main(int argc, char * argv[]) {
 
         /* Create all MEM SWAP */ 
 	int sit;
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+#ifdef MEMSWP_SEQ
+	rdmflag = 0;
+#endif
+	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+#ifdef MEMSWP_FILE
+		if (init_memphy_file(&mswp[sit], memswpsz[sit], rdmflag,
+				MEMSWP_FILE) != 0) {
+			perror("MEMSWP " MEMSWP_FILE);
+			exit(1);
+		}
+#else
 	       init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+#endif
+	}
 
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
@@ -249,7 +487,11 @@ int main(int argc, char * argv[]) {
 #endif
 
 	/* Init scheduler */
-	init_scheduler();
+	init_scheduler(num_cpus);
+#ifdef MLQ_SCHED
+	/* Run queues are per CPU, there is no single MLQ to point to */
+	os.mlq_ready_queue = NULL;
+#endif
 
 	/* Run CPU and loader */
 #ifdef MM_PAGING
@@ -267,9 +509,26 @@ int main(int argc, char * argv[]) {
 		pthread_join(cpu[i], NULL);
 	}
 	pthread_join(ld, NULL);
+	preload_stop();
 
 	/* Stop timer */
 	stop_timer();
+	evlog_stop();
+#ifdef SCHED_STATS
+	sched_stat_report();
+#endif
+	/* On stderr, the trace on stdout keeps the format of output/ */
+	fprintf(stderr, "Migrations: %lu\n", sched_nr_migrations());
+	finish_scheduler();
+#if defined(MM_PAGING) && defined(MEMSWP_SEQ)
+	for (sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+		if (mswp[sit].nr_seek == 0)
+			continue;
+		printf("MEMSWP %d: %llu accesses, seek distance %llu bytes\n",
+			sit, (unsigned long long)mswp[sit].nr_seek,
+			(unsigned long long)mswp[sit].seek_dist);
+	}
+#endif
 
 	return 0;
 
@@ -0,0 +1,111 @@
+/*
+ * Ready queue micro benchmark
+ * Compare the throughput of the mutex protected queue_t against the
+ * lock-free lfqueue_t when 1..64 threads hammer a single queue with
+ * enqueue/dequeue pairs.
+ *
+ * Usage: qbench [ops per thread]
+ */
+
+#include "queue.h"
+#include "lfqueue.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define QBENCH_MAX_THREADS 64
+#define QBENCH_PREFILL 64
+
+static long nr_ops = 200000;
+
+static struct queue_t mtx_queue;
+static pthread_mutex_t mtx_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct lfqueue_t lf_queue;
+
+static pthread_barrier_t start_barrier;
+
+static void * mtx_worker(void * args) {
+	struct pcb_t * proc = (struct pcb_t *)args;
+	long i;
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < nr_ops; i++) {
+		pthread_mutex_lock(&mtx_lock);
+		enqueue(&mtx_queue, proc);
+		pthread_mutex_unlock(&mtx_lock);
+
+		pthread_mutex_lock(&mtx_lock);
+		proc = dequeue(&mtx_queue);
+		pthread_mutex_unlock(&mtx_lock);
+	}
+	return NULL;
+}
+
+static void * lf_worker(void * args) {
+	struct pcb_t * proc = (struct pcb_t *)args;
+	struct pcb_t * next;
+	long i;
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < nr_ops; i++) {
+		while (lfq_enqueue(&lf_queue, proc) != 0)
+			;
+		while ((next = lfq_dequeue(&lf_queue)) == NULL)
+			;
+		proc = next;
+	}
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Return the number of enqueue+dequeue pairs per second */
+static double run(void * (*worker)(void *), int nthreads, struct pcb_t * procs) {
+	pthread_t th[QBENCH_MAX_THREADS];
+	double start;
+	int i;
+
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&th[i], NULL, worker, &procs[i]);
+
+	start = now();
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(th[i], NULL);
+
+	double elapsed = now() - start;
+	pthread_barrier_destroy(&start_barrier);
+	return nthreads * nr_ops / elapsed;
+}
+
+int main(int argc, char * argv[]) {
+	static struct pcb_t procs[QBENCH_MAX_THREADS + QBENCH_PREFILL];
+	int nthreads, i;
+
+	if (argc > 1)
+		nr_ops = atol(argv[1]);
+
+	/* Keep some entries queued so the queues are never drained */
+	lfq_init(&lf_queue, QBENCH_MAX_THREADS + QBENCH_PREFILL);
+	for (i = 0; i < QBENCH_PREFILL; i++) {
+		procs[QBENCH_MAX_THREADS + i].pid = QBENCH_MAX_THREADS + i;
+		enqueue(&mtx_queue, &procs[QBENCH_MAX_THREADS + i]);
+		lfq_enqueue(&lf_queue, &procs[QBENCH_MAX_THREADS + i]);
+	}
+
+	printf("%8s %16s %16s\n", "threads", "mutex (Mops/s)", "lockfree (Mops/s)");
+	for (nthreads = 1; nthreads <= QBENCH_MAX_THREADS; nthreads *= 2) {
+		double mtx = run(mtx_worker, nthreads, procs);
+		double lf = run(lf_worker, nthreads, procs);
+		printf("%8d %16.2f %16.2f\n", nthreads, mtx / 1e6, lf / 1e6);
+	}
+
+	lfq_destroy(&lf_queue);
+	return 0;
+}
@@ -9,19 +9,88 @@ int empty(struct queue_t *q)
         return (q->size == 0);
 }
 
+/* Slot of the i-th entry counted from head */
+static inline int queue_slot(struct queue_t *q, int i)
+{
+        return (q->head + i) % q->cap;
+}
+
+/*
+ * queue_grow - move the live entries into a new ring, dropping holes
+ * The ring is doubled unless removing the holes frees enough room.
+ */
+static int queue_grow(struct queue_t *q)
+{
+        int newcap = q->cap;
+        struct pcb_t **newproc;
+        int i, n = 0;
+
+        if (newcap == 0)
+                newcap = QUEUE_INIT_SIZE;
+        else if (2 * q->size >= q->cap)
+                newcap = 2 * q->cap;
+
+        newproc = malloc(sizeof(struct pcb_t *) * newcap);
+        if (newproc == NULL)
+                return -1;
+
+        for (i = 0; i < q->used; i++) {
+                struct pcb_t *proc = q->proc[queue_slot(q, i)];
+                if (proc != NULL) {
+                        newproc[n] = proc;
+                        proc->q_idx = n;
+                        n++;
+                }
+        }
+
+        free(q->proc);
+        q->proc = newproc;
+        q->cap = newcap;
+        q->head = 0;
+        q->used = n;
+        return 0;
+}
+
+/* Reclaim the holes left at both ends of the ring */
+static void queue_trim(struct queue_t *q)
+{
+        while (q->used > 0 && q->proc[q->head] == NULL) {
+                q->head = (q->head + 1) % q->cap;
+                q->used--;
+        }
+        while (q->used > 0 && q->proc[queue_slot(q, q->used - 1)] == NULL)
+                q->used--;
+}
+
+static struct pcb_t *queue_remove_at(struct queue_t *q, int idx)
+{
+        struct pcb_t *proc = q->proc[idx];
+
+        q->proc[idx] = NULL;
+        proc->q_link = NULL;
+        q->size--;
+        queue_trim(q);
+
+        return proc;
+}
+
 void enqueue(struct queue_t *q, struct pcb_t *proc)
 {
         /* TODO: put a new process to queue [q] */
         if(q == NULL || proc == NULL){
                 return;
         }
-        if (q->size < MAX_QUEUE_SIZE) {
-                q->proc[q->size] = proc;
-                q->size++;
-        }
-        else {
+        if (q->used == q->cap && queue_grow(q) != 0) {
                 fprintf(stderr, "Queue is full, cannot enqueue process.\n");
+                return;
         }
+
+        int idx = queue_slot(q, q->used);
+        q->proc[idx] = proc;
+        proc->q_link = q;
+        proc->q_idx = idx;
+        q->used++;
+        q->size++;
 }
 
 struct pcb_t *dequeue(struct queue_t *q)
@@ -31,34 +100,23 @@ struct pcb_t *dequeue(struct queue_t *q)
          * */
 
         if(q != NULL && q->size > 0){ //if queue not NULL and empty
-                struct pcb_t *proc = NULL;
                 int remove_index = -1;
 #ifdef MLQ_SCHED //if using MLQ
-                proc = q->proc[0]; //because all process prio are equal in a queue, return procces at head of queue
-                remove_index = 0;
+                remove_index = q->head; //because all process prio are equal in a queue, return procces at head of queue
 #else //if not using MLQ
-                int highest_prio = 2147483640;
-                for(int i = 0; i < q->size; i++){ //loop through all process in queue
-                        if(q->proc[i]->priority < highest_prio){ //if prio higher than previous prio
-                                highest_prio = q->proc[i]->priority; //assign current highest prio
-                                remove_index = i; //assign current highest prio index
+                uint32_t highest_prio = 0;
+                for(int i = 0; i < q->used; i++){ //loop through all process in queue
+                        struct pcb_t *proc = q->proc[queue_slot(q, i)];
+                        if(proc == NULL) //skip holes of removed processes
+                                continue;
+                        if(remove_index == -1 || proc->priority < highest_prio){ //if prio higher than previous prio
+                                highest_prio = proc->priority; //assign current highest prio
+                                remove_index = queue_slot(q, i); //assign current highest prio slot
                         }
                 }
-
-                if(remove_index != -1){
-                        proc = q->proc[remove_index];
-                }
 #endif
 
-                if(proc != NULL){
-                        for(int i = remove_index + 1; i < q->size; i++){
-                                q->proc[i - 1] = q->proc[i];
-                        }
-                        q->size--;
-                        q->proc[q->size] = NULL;
-                }
-
-                return proc;
+                return queue_remove_at(q, remove_index);
         }
 
 	return NULL;
@@ -70,26 +128,33 @@ struct pcb_t *purgequeue(struct queue_t *q, struct pcb_t *proc)
          * */
 
         if(q != NULL && proc != NULL && !empty(q)){
-                int index = -1;
-                struct pcb_t *found_proc = NULL;
-
-                for(int i = 0; i < q->size; i++){
-                        if(q->proc[i]->pid == proc->pid){
-                                index = i;
-                                found_proc = q->proc[i];
-                                break;
-                        }
+                /* Fast path: the pcb knows its own slot */
+                if(proc->q_link == q && proc->q_idx >= 0 &&
+                   proc->q_idx < q->cap && q->proc[proc->q_idx] == proc){
+                        return queue_remove_at(q, proc->q_idx);
                 }
 
-                if(index >= 0 && found_proc != NULL){
-                        for(int i = index + 1; i < q->size; i++){
-                                q->proc[i - 1] = q->proc[i];
+                for(int i = 0; i < q->used; i++){
+                        int idx = queue_slot(q, i);
+                        if(q->proc[idx] != NULL && q->proc[idx]->pid == proc->pid){
+                                return queue_remove_at(q, idx);
                         }
-                        q->size--;
-                        q->proc[q->size] = NULL;
+                }
+        }
+        return NULL;
+}
 
-                        return found_proc;
+struct pcb_t *queue_peek(struct queue_t *q, int n)
+{
+        if(q == NULL || n < 0 || n >= q->size){
+                return NULL;
+        }
+
+        for(int i = 0; i < q->used; i++){
+                struct pcb_t *proc = q->proc[queue_slot(q, i)];
+                if(proc != NULL && n-- == 0){
+                        return proc;
                 }
         }
         return NULL;
-}
\ No newline at end of file
+}
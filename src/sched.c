@@ -10,38 +10,627 @@
 
 #include "queue.h"
 #include "sched.h"
+#include "timer.h"
 #include <pthread.h>
 
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef MLQ_LOCKFREE
+#include "lfqueue.h"
+#endif
 static struct queue_t ready_queue;
 static struct queue_t run_queue;
 static pthread_mutex_t queue_lock;
 
 static struct queue_t running_list;
+
+/* Dispatches on another CPU than the previous one of the process */
+static unsigned long nr_migrations;
+
 #ifdef MLQ_SCHED
-static struct queue_t mlq_ready_queue[MAX_PRIO];
-static int slot[MAX_PRIO];
+/*
+ * O(1) lookup state of the MLQ
+ *   prio_bitmap : bit i set <=> mlq_ready_queue[i] is not empty
+ *   expd_bitmap : bit i set <=> prio i has used up its slot[i] in
+ *                 the current round
+ *   slot_epoch  : round in which slot[i] was last refilled, a stale
+ *                 epoch means slot[i] is full (MAX_PRIO - i)
+ * A round reset only clears expd_bitmap and bumps cur_epoch, so its
+ * cost does not depend on MAX_PRIO.
+ */
+#define PRIO_BITS_PER_WORD (8 * sizeof(unsigned long))
+#define PRIO_BITMAP_WORDS ((MAX_PRIO + PRIO_BITS_PER_WORD - 1) / PRIO_BITS_PER_WORD)
+
+/*
+ * Per-CPU run queue: every CPU owns a full MLQ protected by its own
+ * lock, so get_proc/put_proc of different CPUs never contend.
+ * nr_queued is read locklessly by add_proc and the stealer, a stale
+ * value only costs balance.
+ *
+ * With MLQ_LOCKFREE the queues are lock-free rings and rq->lock is
+ * gone: slot, slot_epoch, cur_epoch and expd_bitmap are only touched
+ * by the owner CPU in get_mlq_proc, while prio_bitmap and nr_queued
+ * are updated with atomic operations by any producer or consumer.
+ * A full ring spills over to the unbounded spill[] queue of the same
+ * level under spill_lock. nr_spill[] counts the spilled entries, plus
+ * one while the first spiller settles, and is raised before the spill
+ * enqueue. A producer only uses the ring while nr_spill is 0, which it
+ * checks again after announcing itself in nr_ring_push[], and the
+ * first spiller waits for those announced pushes to land. So the ring
+ * is always older than the spill and FIFO order holds.
+ */
+struct mlq_rq_t {
+#ifdef MLQ_LOCKFREE
+	struct lfqueue_t mlq_ready_queue[MAX_PRIO];
+	pthread_mutex_t spill_lock;
+	struct queue_t spill[MAX_PRIO];
+	int nr_spill[MAX_PRIO];
+	int nr_ring_push[MAX_PRIO];
+#else
+	pthread_mutex_t lock;
+	struct queue_t mlq_ready_queue[MAX_PRIO];
+#endif
+	int slot[MAX_PRIO];
+	unsigned long slot_epoch[MAX_PRIO];
+	unsigned long cur_epoch;
+	unsigned long prio_bitmap[PRIO_BITMAP_WORDS];
+	unsigned long expd_bitmap[PRIO_BITMAP_WORDS];
+	int nr_queued;
+	int aff_skips;	/* Dispatches which passed over a queue head in a row */
+} __attribute__((aligned(64)));
+
+static struct mlq_rq_t *mlq_rq;
+static int mlq_nr_rq;
+
+#ifdef MLQ_LOCKFREE
+#define rq_lock(rq)
+#define rq_unlock(rq)
+#else
+#define rq_lock(rq) pthread_mutex_lock(&(rq)->lock)
+#define rq_unlock(rq) pthread_mutex_unlock(&(rq)->lock)
+#endif
+
+static inline void prio_set(unsigned long *map, int prio) {
+	map[prio / PRIO_BITS_PER_WORD] |= 1UL << (prio % PRIO_BITS_PER_WORD);
+}
+
+static inline void prio_clear(unsigned long *map, int prio) {
+	map[prio / PRIO_BITS_PER_WORD] &= ~(1UL << (prio % PRIO_BITS_PER_WORD));
+}
+
+#ifdef MLQ_LOCKFREE
+/* prio_bitmap is shared by all producers and consumers of the rq */
+static inline void qmap_set(struct mlq_rq_t *rq, int prio) {
+	__atomic_fetch_or(&rq->prio_bitmap[prio / PRIO_BITS_PER_WORD],
+			1UL << (prio % PRIO_BITS_PER_WORD), __ATOMIC_SEQ_CST);
+}
+
+static inline void qmap_clear(struct mlq_rq_t *rq, int prio) {
+	__atomic_fetch_and(&rq->prio_bitmap[prio / PRIO_BITS_PER_WORD],
+			~(1UL << (prio % PRIO_BITS_PER_WORD)), __ATOMIC_SEQ_CST);
+}
+#else
+#define qmap_set(rq, prio) prio_set((rq)->prio_bitmap, prio)
+#define qmap_clear(rq, prio) prio_clear((rq)->prio_bitmap, prio)
+#endif
+
+/* Highest priority (lowest index) set in map & ~mask, -1 if none */
+static inline int prio_first(unsigned long *map, unsigned long *mask) {
+	unsigned long w;
+	for (w = 0; w < PRIO_BITMAP_WORDS; w++) {
+		unsigned long bits = __atomic_load_n(&map[w], __ATOMIC_RELAXED) &
+				(mask ? ~mask[w] : ~0UL);
+		if (bits)
+			return w * PRIO_BITS_PER_WORD + __builtin_ctzl(bits);
+	}
+	return -1;
+}
+
+/* Refill slot[prio] if it has not been touched since the last reset */
+static inline int *prio_slot(struct mlq_rq_t *rq, int prio) {
+	if (rq->slot_epoch[prio] != rq->cur_epoch) {
+		rq->slot[prio] = MAX_PRIO - prio;
+		rq->slot_epoch[prio] = rq->cur_epoch;
+	}
+	return &rq->slot[prio];
+}
+
+static inline int rq_load(struct mlq_rq_t *rq) {
+	return __atomic_load_n(&rq->nr_queued, __ATOMIC_RELAXED);
+}
+
+#ifdef MLQ_LOCKFREE
+static inline int rq_spilled(struct mlq_rq_t *rq, int prio) {
+	return __atomic_load_n(&rq->nr_spill[prio], __ATOMIC_SEQ_CST);
+}
+
+/* Queue [proc] on the ring of its level unless the level has spilled */
+static int rq_ring_push(struct mlq_rq_t *rq, struct pcb_t *proc) {
+	int prio = proc->prio, ret = -1;
+
+	if (rq_spilled(rq, prio) > 0)
+		return -1;
+	__atomic_fetch_add(&rq->nr_ring_push[prio], 1, __ATOMIC_SEQ_CST);
+	if (rq_spilled(rq, prio) == 0)
+		ret = lfq_enqueue(&rq->mlq_ready_queue[prio], proc);
+	__atomic_fetch_sub(&rq->nr_ring_push[prio], 1, __ATOMIC_SEQ_CST);
+	return ret;
+}
+
+/*
+ * rq_spill - queue [proc] on the spill of its level
+ * The first spiller closes the ring, waits for the ring pushes already
+ * under way (bounded, they do not wait for a consumer) and tries the
+ * ring once more, since a consumer may have freed a slot meanwhile.
+ */
+static void rq_spill(struct mlq_rq_t *rq, struct pcb_t *proc) {
+	int prio = proc->prio;
+
+	pthread_mutex_lock(&rq->spill_lock);
+	if (__atomic_fetch_add(&rq->nr_spill[prio], 1, __ATOMIC_SEQ_CST) == 0) {
+		while (__atomic_load_n(&rq->nr_ring_push[prio], __ATOMIC_SEQ_CST) > 0)
+			;
+		if (lfq_enqueue(&rq->mlq_ready_queue[prio], proc) == 0) {
+			__atomic_fetch_sub(&rq->nr_spill[prio], 1, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&rq->spill_lock);
+			return;
+		}
+	}
+	enqueue(&rq->spill[prio], proc);
+	pthread_mutex_unlock(&rq->spill_lock);
+}
+
+/* Number of processes queued on level [prio], ring and spill */
+static inline int rq_level_size(struct mlq_rq_t *rq, int prio) {
+	return lfq_size(&rq->mlq_ready_queue[prio]) + rq_spilled(rq, prio);
+}
+#endif
+
+/* Caller holds rq->lock */
+static void rq_enqueue(struct mlq_rq_t *rq, struct pcb_t *proc) {
+#ifdef MLQ_LOCKFREE
+	if (rq_ring_push(rq, proc) != 0)
+		rq_spill(rq, proc);
+#else
+	enqueue(&rq->mlq_ready_queue[proc->prio], proc);
+#endif
+	qmap_set(rq, proc->prio);
+	__atomic_fetch_add(&rq->nr_queued, 1, __ATOMIC_RELAXED);
+}
+
+/* Caller holds rq->lock. May return NULL if a stealer won the race */
+static struct pcb_t *rq_dequeue(struct mlq_rq_t *rq, int prio) {
+#ifdef MLQ_LOCKFREE
+	struct lfqueue_t *q = &rq->mlq_ready_queue[prio];
+	struct pcb_t *proc = lfq_dequeue(q);
+
+	if (proc == NULL && rq_spilled(rq, prio) > 0) {
+		pthread_mutex_lock(&rq->spill_lock);
+		proc = dequeue(&rq->spill[prio]);
+		if (proc != NULL)
+			__atomic_fetch_sub(&rq->nr_spill[prio], 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&rq->spill_lock);
+	}
+	if (rq_level_size(rq, prio) == 0) {
+		qmap_clear(rq, prio);
+		/* A producer may have slipped in before the clear */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (rq_level_size(rq, prio) > 0)
+			qmap_set(rq, prio);
+	}
+#else
+	struct pcb_t *proc = dequeue(&rq->mlq_ready_queue[prio]);
+
+	if (empty(&rq->mlq_ready_queue[prio]))
+		qmap_clear(rq, prio);
+#endif
+	if (proc != NULL)
+		__atomic_fetch_sub(&rq->nr_queued, 1, __ATOMIC_RELAXED);
+	return proc;
+}
+
+#if !defined(MLQ_LOCKFREE) && MLQ_AFFINITY_WINDOW > 0
+/*
+ * rq_dequeue_affine - dequeue from [prio] preferring cache affinity
+ * Take the head unless it last ran on another CPU and one of the
+ * next MLQ_AFFINITY_WINDOW entries last ran on [cpu]. The skip count
+ * bounds how long the head can be passed over. Caller holds rq->lock.
+ */
+static struct pcb_t *rq_dequeue_affine(struct mlq_rq_t *rq, int prio, int cpu) {
+	struct queue_t *q = &rq->mlq_ready_queue[prio];
+	struct pcb_t *head = queue_peek(q, 0);
+	int i;
+
+	if (head != NULL && head->last_cpu >= 0 && head->last_cpu != cpu &&
+	    rq->aff_skips < MLQ_AFFINITY_WINDOW) {
+		for (i = 1; i <= MLQ_AFFINITY_WINDOW; i++) {
+			struct pcb_t *proc = queue_peek(q, i);
+			if (proc == NULL)
+				break;
+			if (proc->last_cpu == cpu) {
+				purgequeue(q, proc);
+				if (empty(q))
+					qmap_clear(rq, prio);
+				__atomic_fetch_sub(&rq->nr_queued, 1, __ATOMIC_RELAXED);
+				rq->aff_skips++;
+				return proc;
+			}
+		}
+	}
+
+	rq->aff_skips = 0;
+	return rq_dequeue(rq, prio);
+}
+#else
+#define rq_dequeue_affine(rq, prio, cpu) rq_dequeue(rq, prio)
+#endif
+
+/* rq_push - queue [proc] on [rq], never blocks on a full level */
+static void rq_push(struct mlq_rq_t *rq, struct pcb_t *proc) {
+	proc->krnl->ready_queue = &ready_queue;
+	proc->krnl->running_list = &running_list;
+	rq_lock(rq);
+	rq_enqueue(rq, proc);
+	rq_unlock(rq);
+}
+#endif
+
+#ifdef CFS_SCHED
+#ifndef MLQ_SCHED
+#error "CFS_SCHED derives weights from prio and needs MLQ_SCHED"
 #endif
+/*
+ * Fair scheduler class
+ * Runnable processes are kept in a binary min-heap ordered by
+ * vruntime, the run time weighted by 1/weight(prio), so get and put
+ * are O(log n). A process with weight w receives a CPU share of
+ * w / sum(w) of the runnable set.
+ */
+#define CFS_VRT_SHIFT 20	/* vruntime fixed point */
+#define CFS_NICE_0_LOAD 1024
+
+/* Linux nice -20..19 to weight table, each step is ~10% of CPU */
+static const uint32_t cfs_prio_to_weight[40] = {
+	88761, 71755, 56483, 46273, 36291,
+	29154, 23254, 18705, 14949, 11916,
+	 9548,  7620,  6100,  4904,  3906,
+	 3121,  2501,  1991,  1586,  1277,
+	 1024,   820,   655,   526,   423,
+	  335,   272,   215,   172,   137,
+	  110,    87,    70,    56,    45,
+	   36,    29,    23,    18,    15,
+};
+
+static struct {
+	struct pcb_t **heap;
+	int size;
+	int cap;
+	uint64_t min_vruntime;	/* Never decreases, start point of new comers */
+} cfs_rq;
+
+/* Map prio 0..MAX_PRIO-1 (0 is the highest) onto nice -20..19 */
+static inline uint32_t cfs_weight(struct pcb_t *proc) {
+	uint32_t prio = proc->prio < MAX_PRIO ? proc->prio : MAX_PRIO - 1;
+	return cfs_prio_to_weight[prio * 40 / MAX_PRIO];
+}
+
+/* Heap order: smaller vruntime first, pid breaks ties */
+static inline int cfs_before(struct pcb_t *a, struct pcb_t *b) {
+	if (a->vruntime != b->vruntime)
+		return a->vruntime < b->vruntime;
+	return a->pid < b->pid;
+}
+
+static void cfs_sift_up(int i) {
+	struct pcb_t *proc = cfs_rq.heap[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!cfs_before(proc, cfs_rq.heap[parent]))
+			break;
+		cfs_rq.heap[i] = cfs_rq.heap[parent];
+		i = parent;
+	}
+	cfs_rq.heap[i] = proc;
+}
+
+static void cfs_sift_down(int i) {
+	struct pcb_t *proc = cfs_rq.heap[i];
+
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= cfs_rq.size)
+			break;
+		if (child + 1 < cfs_rq.size &&
+		    cfs_before(cfs_rq.heap[child + 1], cfs_rq.heap[child]))
+			child++;
+		if (!cfs_before(cfs_rq.heap[child], proc))
+			break;
+		cfs_rq.heap[i] = cfs_rq.heap[child];
+		i = child;
+	}
+	cfs_rq.heap[i] = proc;
+}
+
+/* Caller holds queue_lock */
+static void cfs_enqueue(struct pcb_t *proc) {
+	if (cfs_rq.size == cfs_rq.cap) {
+		int cap = cfs_rq.cap ? 2 * cfs_rq.cap : QUEUE_INIT_SIZE;
+		struct pcb_t **heap = realloc(cfs_rq.heap, sizeof(struct pcb_t *) * cap);
+		if (heap == NULL) {
+			fprintf(stderr, "Queue is full, cannot enqueue process.\n");
+			return;
+		}
+		cfs_rq.heap = heap;
+		cfs_rq.cap = cap;
+	}
+	cfs_rq.heap[cfs_rq.size++] = proc;
+	cfs_sift_up(cfs_rq.size - 1);
+}
+
+/* Caller holds queue_lock */
+static struct pcb_t *cfs_dequeue(void) {
+	struct pcb_t *proc;
+
+	if (cfs_rq.size == 0)
+		return NULL;
+
+	proc = cfs_rq.heap[0];
+	cfs_rq.size--;
+	if (cfs_rq.size > 0) {
+		cfs_rq.heap[0] = cfs_rq.heap[cfs_rq.size];
+		cfs_sift_down(0);
+	}
+
+	if (proc->vruntime > cfs_rq.min_vruntime)
+		cfs_rq.min_vruntime = proc->vruntime;
+	return proc;
+}
+
+struct pcb_t * get_cfs_proc(int cpu) {
+	struct pcb_t * proc;
+
+	pthread_mutex_lock(&queue_lock);
+	proc = cfs_dequeue();
+	if (proc != NULL)
+		proc->exec_start = current_time();
+	pthread_mutex_unlock(&queue_lock);
+
+	return proc;
+}
+
+void put_cfs_proc(int cpu, struct pcb_t * proc) {
+	uint64_t delta = current_time() - proc->exec_start;
+
+	proc->krnl->ready_queue = &ready_queue;
+	proc->krnl->running_list = &running_list;
+
+	/* Charge the slots just consumed, scaled by 1/weight */
+	proc->vruntime += (delta * CFS_NICE_0_LOAD << CFS_VRT_SHIFT) / cfs_weight(proc);
+
+	pthread_mutex_lock(&queue_lock);
+	cfs_enqueue(proc);
+	pthread_mutex_unlock(&queue_lock);
+}
+
+void add_cfs_proc(struct pcb_t * proc) {
+	proc->krnl->ready_queue = &ready_queue;
+	proc->krnl->running_list = &running_list;
+
+	pthread_mutex_lock(&queue_lock);
+	/* A new comer starts level with the others instead of at 0,
+	 * which would let it monopolize the CPUs */
+	proc->vruntime = cfs_rq.min_vruntime;
+	cfs_enqueue(proc);
+	pthread_mutex_unlock(&queue_lock);
+}
+#endif
+
+#ifdef SCHED_STATS
+/*
+ * Scheduling history: the pcb counters are updated on every queueing
+ * and dispatch, and copied here when the process finishes since its
+ * pcb is freed right after.
+ */
+struct sched_stat_t {
+	uint32_t prio;
+	uint64_t turnaround;	/* finish - arrival */
+	uint64_t response;	/* first dispatch - arrival */
+	uint64_t wait;		/* time spent in ready queues */
+	uint32_t nr_dispatch;
+	uint32_t run_slots;
+};
+
+static struct sched_stat_t *stat_rec;
+static int stat_nr;
+static int stat_cap;
+static pthread_mutex_t stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef MLQ_SCHED
+#define STAT_PRIO(proc) ((proc)->prio)
+#else
+#define STAT_PRIO(proc) ((proc)->priority)
+#endif
+
+static inline void stat_queued(struct pcb_t *proc) {
+	proc->ready_since = current_time();
+}
+
+static inline void stat_arrived(struct pcb_t *proc) {
+	proc->arrival = current_time();
+	proc->first_run = 0;
+	proc->wait = 0;
+	proc->nr_dispatch = 0;
+	proc->run_slots = 0;
+	stat_queued(proc);
+}
+
+static inline void stat_dispatched(struct pcb_t *proc) {
+	uint64_t now = current_time();
+
+	proc->wait += now - proc->ready_since;
+	if (proc->nr_dispatch == 0)
+		proc->first_run = now;
+	proc->nr_dispatch++;
+}
+
+void sched_stat_exit(struct pcb_t * proc) {
+	struct sched_stat_t *rec;
+
+	pthread_mutex_lock(&stat_lock);
+	if (stat_nr == stat_cap) {
+		int cap = stat_cap ? 2 * stat_cap : 64;
+		rec = realloc(stat_rec, sizeof(struct sched_stat_t) * cap);
+		if (rec == NULL) {
+			pthread_mutex_unlock(&stat_lock);
+			return;
+		}
+		stat_rec = rec;
+		stat_cap = cap;
+	}
+	rec = &stat_rec[stat_nr++];
+	rec->prio = STAT_PRIO(proc);
+	rec->turnaround = current_time() - proc->arrival;
+	rec->response = proc->first_run - proc->arrival;
+	rec->wait = proc->wait;
+	rec->nr_dispatch = proc->nr_dispatch;
+	rec->run_slots = proc->run_slots;
+	pthread_mutex_unlock(&stat_lock);
+}
+
+static int stat_cmp_prio(const void *a, const void *b) {
+	const struct sched_stat_t *x = a, *y = b;
+	return (x->prio > y->prio) - (x->prio < y->prio);
+}
+
+static int stat_cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Print p50/p90/p99/max of [val] which gets sorted */
+static void stat_print_pct(uint64_t *val, int n) {
+	qsort(val, n, sizeof(uint64_t), stat_cmp_u64);
+	printf(" %6lu %6lu %6lu %6lu |",
+		(unsigned long)val[(n - 1) * 50 / 100],
+		(unsigned long)val[(n - 1) * 90 / 100],
+		(unsigned long)val[(n - 1) * 99 / 100],
+		(unsigned long)val[n - 1]);
+}
+
+void sched_stat_report(void) {
+	uint64_t *turnaround, *response, *wait;
+	int i, j, k;
+
+	pthread_mutex_lock(&stat_lock);
+	printf("Scheduling statistics (time slots, p50 p90 p99 max)\n");
+	printf("%4s %5s |%-29s|%-29s|%-29s| %8s %8s\n", "prio", "nproc",
+		" turnaround", " response", " wait", "dispatch", "cpu");
+	if (stat_nr == 0) {
+		pthread_mutex_unlock(&stat_lock);
+		return;
+	}
+
+	qsort(stat_rec, stat_nr, sizeof(struct sched_stat_t), stat_cmp_prio);
+	turnaround = malloc(sizeof(uint64_t) * stat_nr);
+	response = malloc(sizeof(uint64_t) * stat_nr);
+	wait = malloc(sizeof(uint64_t) * stat_nr);
+
+	for (i = 0; i < stat_nr; i = j) {
+		unsigned long nr_dispatch = 0, run_slots = 0;
+
+		for (j = i; j < stat_nr && stat_rec[j].prio == stat_rec[i].prio; j++) {
+			k = j - i;
+			turnaround[k] = stat_rec[j].turnaround;
+			response[k] = stat_rec[j].response;
+			wait[k] = stat_rec[j].wait;
+			nr_dispatch += stat_rec[j].nr_dispatch;
+			run_slots += stat_rec[j].run_slots;
+		}
+
+		printf("%4u %5d |", stat_rec[i].prio, j - i);
+		stat_print_pct(turnaround, j - i);
+		stat_print_pct(response, j - i);
+		stat_print_pct(wait, j - i);
+		printf(" %8lu %8lu\n", nr_dispatch, run_slots);
+	}
+
+	free(turnaround);
+	free(response);
+	free(wait);
+	pthread_mutex_unlock(&stat_lock);
+}
+#else
+#define stat_queued(proc)
+#define stat_arrived(proc)
+#define stat_dispatched(proc)
+#endif
+
+unsigned long sched_nr_migrations(void) {
+	return __atomic_load_n(&nr_migrations, __ATOMIC_RELAXED);
+}
 
 int queue_empty(void) {
+#ifdef CFS_SCHED
+	if (__atomic_load_n(&cfs_rq.size, __ATOMIC_RELAXED) > 0)
+		return 0;
+#endif
 #ifdef MLQ_SCHED
-	unsigned long prio;
-	for (prio = 0; prio < MAX_PRIO; prio++)
-		if(!empty(&mlq_ready_queue[prio])) 
-			return -1;
+	int cpu;
+	for (cpu = 0; cpu < mlq_nr_rq; cpu++)
+		if (rq_load(&mlq_rq[cpu]) > 0)
+			return 0;
 #endif
 	return (empty(&ready_queue) && empty(&run_queue));
 }
 
-void init_scheduler(void) {
+void init_scheduler(int num_cpus) {
 #ifdef MLQ_SCHED
-    int i ;
-
-	for (i = 0; i < MAX_PRIO; i ++) {
-		mlq_ready_queue[i].size = 0;
-		slot[i] = MAX_PRIO - i; 
+	int cpu;
+
+	if (num_cpus < 1)
+		num_cpus = 1;
+	mlq_nr_rq = num_cpus;
+	mlq_rq = aligned_alloc(64, sizeof(struct mlq_rq_t) * num_cpus);
+	if (mlq_rq == NULL) {
+		perror("init_scheduler");
+		exit(1);
 	}
+	for (cpu = 0; cpu < num_cpus; cpu++) {
+		struct mlq_rq_t *rq = &mlq_rq[cpu];
+		int i;
+
+		for (i = 0; i < MAX_PRIO; i ++) {
+#ifdef MLQ_LOCKFREE
+			lfq_init(&rq->mlq_ready_queue[i], MLQ_LF_RING_SZ);
+			rq->spill[i] = (struct queue_t){ 0 };
+			rq->nr_spill[i] = 0;
+			rq->nr_ring_push[i] = 0;
+#else
+			rq->mlq_ready_queue[i] = (struct queue_t){ 0 };
+#endif
+			rq->slot[i] = MAX_PRIO - i;
+			rq->slot_epoch[i] = 0;
+		}
+		for (i = 0; i < PRIO_BITMAP_WORDS; i++) {
+			rq->prio_bitmap[i] = 0;
+			rq->expd_bitmap[i] = 0;
+		}
+		rq->cur_epoch = 0;
+		rq->nr_queued = 0;
+		rq->aff_skips = 0;
+#ifdef MLQ_LOCKFREE
+		pthread_mutex_init(&rq->spill_lock, NULL);
+#else
+		pthread_mutex_init(&rq->lock, NULL);
+#endif
+	}
+#endif
+#ifdef CFS_SCHED
+	cfs_rq.heap = NULL;
+	cfs_rq.size = 0;
+	cfs_rq.cap = 0;
+	cfs_rq.min_vruntime = 0;
 #endif
 	ready_queue.size = 0;
 	run_queue.size = 0;
@@ -49,56 +638,134 @@ void init_scheduler(void) {
 	pthread_mutex_init(&queue_lock, NULL);
 }
 
+void finish_scheduler(void) {
 #ifdef MLQ_SCHED
+	int cpu, i;
+
+	for (cpu = 0; cpu < mlq_nr_rq; cpu++) {
+#ifdef MLQ_LOCKFREE
+		for (i = 0; i < MAX_PRIO; i++) {
+			lfq_destroy(&mlq_rq[cpu].mlq_ready_queue[i]);
+			free(mlq_rq[cpu].spill[i].proc);
+		}
+		pthread_mutex_destroy(&mlq_rq[cpu].spill_lock);
+#else
+		for (i = 0; i < MAX_PRIO; i++)
+			free(mlq_rq[cpu].mlq_ready_queue[i].proc);
+		pthread_mutex_destroy(&mlq_rq[cpu].lock);
+#endif
+	}
+	free(mlq_rq);
+	mlq_rq = NULL;
+	mlq_nr_rq = 0;
+#endif
+#ifdef SCHED_STATS
+	free(stat_rec);
+	stat_rec = NULL;
+	stat_nr = stat_cap = 0;
+#endif
+#ifdef CFS_SCHED
+	free(cfs_rq.heap);
+	cfs_rq.heap = NULL;
+#endif
+	pthread_mutex_destroy(&queue_lock);
+}
+
+#ifdef MLQ_SCHED
+/*
+ * steal_mlq_proc - pull work from the busiest other CPU
+ * Half (rounded up, at most 64) of the victim's highest priority
+ * queue is moved to [cpu]. The two run queue locks are never held
+ * together.
+ * Return the number of stolen processes.
+ */
+static int steal_mlq_proc(int cpu) {
+	struct pcb_t *stolen[64], *proc;
+	struct mlq_rq_t *victim = NULL;
+	int vload = 0, nr = 0, i;
+
+	for (i = 1; i < mlq_nr_rq; i++) {
+		struct mlq_rq_t *rq = &mlq_rq[(cpu + i) % mlq_nr_rq];
+		int load = rq_load(rq);
+		if (load > vload) {
+			vload = load;
+			victim = rq;
+		}
+	}
+	if (victim == NULL)
+		return 0;
+
+	rq_lock(victim);
+	int prio = prio_first(victim->prio_bitmap, NULL);
+	if (prio >= 0) {
+#ifdef MLQ_LOCKFREE
+		int half = (rq_level_size(victim, prio) + 1) / 2;
+#else
+		int half = (victim->mlq_ready_queue[prio].size + 1) / 2;
+#endif
+		if (half > 64)
+			half = 64;
+		while (nr < half && (proc = rq_dequeue(victim, prio)) != NULL)
+			stolen[nr++] = proc;
+	}
+	rq_unlock(victim);
+
+	for (i = 0; i < nr; i++)
+		rq_push(&mlq_rq[cpu], stolen[i]);
+	return nr;
+}
+
 /* 
  *  Stateful design for routine calling
  *  based on the priority and our MLQ policy
  *  We implement stateful here using transition technique
  *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
  */
-struct pcb_t * get_mlq_proc(void) {
+struct pcb_t * get_mlq_proc(int cpu) {
 	struct pcb_t * proc = NULL;
+	struct mlq_rq_t *rq = &mlq_rq[cpu % mlq_nr_rq];
 
-	pthread_mutex_lock(&queue_lock);
+	/* An idle CPU looks for work on the others first */
+	if (rq_load(rq) == 0 && mlq_nr_rq > 1)
+		steal_mlq_proc(cpu % mlq_nr_rq);
+
+	rq_lock(rq);
 	/*TODO: get a process from PRIORITY [ready_queue].
 	 *      It worth to protect by a mechanism.
 	 * */
 
-	for(int i = 0; i < MAX_PRIO; i++){ //loop from highest prio queue to lowest (lower prio means higher priority)
-		if(!empty(&mlq_ready_queue[i]) && slot[i] > 0){ //if queue is not empty and there are still slots in the CPU for that priority
-			proc = dequeue(&mlq_ready_queue[i]);
-			slot[i]--; //consume a slot in the running
+	while (proc == NULL) {
+		int prio = prio_first(rq->prio_bitmap, rq->expd_bitmap); //highest prio queue which still has slots
+		if (prio < 0) {
+			/* All queued prio exhausted their slots, start a new round:
+			 * every slot[] is lazily refilled on its next use */
+			unsigned long w;
+			for (w = 0; w < PRIO_BITMAP_WORDS; w++)
+				rq->expd_bitmap[w] = 0;
+			rq->cur_epoch++;
 			break;
 		}
-	}
 
-	int no_runnable_with_slot = 1;
-	if(proc == NULL){
-		for(int i = 0; i < MAX_PRIO; i++){ //loop through all slots and mlq
-			if(slot[i] > 0 && !empty(&mlq_ready_queue[i])){ //if there are still slots at prio i and process is still in that prio
-				no_runnable_with_slot = 0; //current MLQ is not exhausted
-				break;
-			}
-		}
-	}
+		/* NULL only if a stealer emptied this level, then look again */
+		proc = rq_dequeue_affine(rq, prio, cpu % mlq_nr_rq);
+		if (proc != NULL) {
+			int *pslot = prio_slot(rq, prio);
 
-	if(proc == NULL && no_runnable_with_slot == 1){ //if all queue exhausted
-		for (int i = 0; i < MAX_PRIO; i ++) {
-			slot[i] = MAX_PRIO - i; //reset all available slots
+			(*pslot)--; //consume a slot in the running
+			if (*pslot <= 0)
+				prio_set(rq->expd_bitmap, prio);
 		}
 	}
-	
+
 	// if (proc != NULL) //ìf there are available process, enqueue it back to the queue
 	// 	enqueue(&running_list, proc);
 
-	pthread_mutex_unlock(&queue_lock);
+	rq_unlock(rq);
 	return proc;	//return process for dispatch
 }
 
-void put_mlq_proc(struct pcb_t * proc) {
-	proc->krnl->ready_queue = &ready_queue;
-	proc->krnl->mlq_ready_queue = mlq_ready_queue;
-	proc->krnl->running_list = &running_list;
+void put_mlq_proc(int cpu, struct pcb_t * proc) {
+	struct mlq_rq_t *rq = &mlq_rq[cpu % mlq_nr_rq];
 
 	/* TODO: put running proc to running_list 
 	 *       It worth to protect by a mechanism.
@@ -107,39 +774,65 @@ void put_mlq_proc(struct pcb_t * proc) {
 
 
 
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);
+	rq_push(rq, proc);
 }
 
 void add_mlq_proc(struct pcb_t * proc) {
-	proc->krnl->ready_queue = &ready_queue;
-	proc->krnl->mlq_ready_queue = mlq_ready_queue;
-	proc->krnl->running_list = &running_list;
+	struct mlq_rq_t *rq = &mlq_rq[0];
+	int cpu, load = rq_load(rq);
+
+	/* New process goes to the least loaded CPU */
+	for (cpu = 1; cpu < mlq_nr_rq && load > 0; cpu++) {
+		if (rq_load(&mlq_rq[cpu]) < load) {
+			rq = &mlq_rq[cpu];
+			load = rq_load(rq);
+		}
+	}
 
 	/* TODO: put running proc to running_list
 	 *       It worth to protect by a mechanism.
 	 * 
 	 */
-       
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);	
+
+	rq_push(rq, proc);
 }
 
-struct pcb_t * get_proc(void) {
-	return get_mlq_proc();
+struct pcb_t * get_proc(int cpu) {
+	struct pcb_t * proc;
+#ifdef CFS_SCHED
+	proc = get_cfs_proc(cpu);
+#else
+	proc = get_mlq_proc(cpu);
+#endif
+	if (proc != NULL) {
+		if (proc->last_cpu >= 0 && proc->last_cpu != cpu)
+			__atomic_fetch_add(&nr_migrations, 1, __ATOMIC_RELAXED);
+		proc->last_cpu = cpu;
+		stat_dispatched(proc);
+	}
+	return proc;
 }
 
-void put_proc(struct pcb_t * proc) {
-	return put_mlq_proc(proc);
+void put_proc(int cpu, struct pcb_t * proc) {
+	/* Stamp before queueing, another CPU may pick it up at once */
+	stat_queued(proc);
+#ifdef CFS_SCHED
+	return put_cfs_proc(cpu, proc);
+#else
+	return put_mlq_proc(cpu, proc);
+#endif
 }
 
 void add_proc(struct pcb_t * proc) {
+	stat_arrived(proc);
+#ifdef CFS_SCHED
+	return add_cfs_proc(proc);
+#else
 	return add_mlq_proc(proc);
+#endif
 }
 #else
-struct pcb_t * get_proc(void) {
+struct pcb_t * get_proc(int cpu) {
 	struct pcb_t * proc = NULL;
 
 	pthread_mutex_lock(&queue_lock);
@@ -153,7 +846,7 @@ struct pcb_t * get_proc(void) {
 	return proc;
 }
 
-void put_proc(struct pcb_t * proc) {
+void put_proc(int cpu, struct pcb_t * proc) {
 	proc->krnl->ready_queue = &ready_queue;
 	proc->krnl->running_list = &running_list;
 
@@ -178,7 +871,7 @@ void add_proc(struct pcb_t * proc) {
 
 	pthread_mutex_lock(&queue_lock);
 	enqueue(&ready_queue, proc);
-	pthread_mutex_unlock(&queue_lock);	
+	pthread_mutex_unlock(&queue_lock);
 }
 #endif
 
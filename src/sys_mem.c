@@ -10,6 +10,7 @@
 
 #include "os-mm.h"
 #include "syscall.h"
+#include "evlog.h"
 #include "libmem.h"
 #include "queue.h"
 #include <stdlib.h>
@@ -65,7 +66,7 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
             MEMPHY_write(caller->krnl->mram, regs->a2, regs->a3);
             break;
    default:
-            printf("Memop code: %d\n", memop);
+            evlog_printf("Memop code: %d\n", memop);
             break;
    }
    
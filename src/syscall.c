@@ -36,7 +36,7 @@ int __sys_ni_syscall(struct krnl_t *krnl, struct sc_regs *regs)
 }
 
 #define __SYSCALL(nr, sym) case nr: return __##sym(krnl,pid,regs);
-int syscall(struct krnl_t *krnl, uint32_t pid, uint32_t nr, struct sc_regs* regs)
+int krnl_syscall(struct krnl_t *krnl, uint32_t pid, uint32_t nr, struct sc_regs* regs)
 {
 	switch (nr) {
 	#include "syscalltbl.lst"
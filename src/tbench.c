@@ -0,0 +1,82 @@
+/*
+ * Timer micro benchmark
+ * Attach 2..128 devices that do nothing but call next_slot() and
+ * report how many time slots per second the timer can drive.
+ *
+ * Usage: tbench [slots per run]
+ */
+
+#include "timer.h"
+#include "evlog.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TBENCH_MAX_DEVS 128
+
+static long nr_slots = 20000;
+
+static void * dev_routine(void * args) {
+	struct timer_id_t * timer_id = (struct timer_id_t *)args;
+	long i;
+
+	for (i = 0; i < nr_slots; i++)
+		next_slot(timer_id);
+	detach_event(timer_id);
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Return the number of time slots per second with [ndevs] devices */
+static double run(int ndevs) {
+	struct timer_id_t * ids[TBENCH_MAX_DEVS];
+	pthread_t th[TBENCH_MAX_DEVS];
+	double start;
+	int i;
+
+	for (i = 0; i < ndevs; i++)
+		ids[i] = attach_event();
+
+	start = now();
+	evlog_start();
+	start_timer();
+	for (i = 0; i < ndevs; i++)
+		pthread_create(&th[i], NULL, dev_routine, ids[i]);
+	for (i = 0; i < ndevs; i++)
+		pthread_join(th[i], NULL);
+	stop_timer();
+	evlog_stop();
+
+	return nr_slots / (now() - start);
+}
+
+int main(int argc, char * argv[]) {
+	FILE * out;
+	int ndevs;
+
+	if (argc > 1)
+		nr_slots = atol(argv[1]);
+
+	/* The timer prints every time slot, keep it off the report */
+	out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+		perror("tbench");
+		return 1;
+	}
+
+	fprintf(out, "%8s %16s\n", "cpus", "slots/s");
+	for (ndevs = 2; ndevs <= TBENCH_MAX_DEVS; ndevs *= 2) {
+		fprintf(out, "%8d %16.0f\n", ndevs, run(ndevs));
+		fflush(out);
+	}
+
+	fclose(out);
+	return 0;
+}
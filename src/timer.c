@@ -1,9 +1,16 @@
 
 #include "timer.h"
+#include "os-cfg.h"
+#include "evlog.h"
+#include <limits.h>
+#include <linux/futex.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-static pthread_t _timer;
+/* Number of polls on the barrier before sleeping in the kernel */
+#define TIMER_SPIN 100
 
 struct timer_id_container_t {
 	struct timer_id_t id;
@@ -15,81 +22,99 @@ static struct timer_id_container_t * dev_list = NULL;
 static uint64_t _time;
 
 static int timer_started = 0;
-static int timer_stop = 0;
-
-
-static void * timer_routine(void * args) {
-	while (!timer_stop) {
-		printf("Time slot %3llu\n", current_time());
-		int fsh = 0;
-		int event = 0;
-		/* Wait for all devices have done the job in current
-		 * time slot */
-		struct timer_id_container_t * temp;
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.event_lock);
-			while (!temp->id.done && !temp->id.fsh) {
-				pthread_cond_wait(
-					&temp->id.event_cond,
-					&temp->id.event_lock
-				);
-			}
-			if (temp->id.fsh) {
-				fsh++;
-			}
-			event++;
-			pthread_mutex_unlock(&temp->id.event_lock);
-		}
 
-		/* Increase the time slot */
-		_time++;
-		
-		/* Let devices continue their job */
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.timer_lock);
-			temp->id.done = 0;
-			pthread_cond_signal(&temp->id.timer_cond);
-			pthread_mutex_unlock(&temp->id.timer_lock);
-		}
-		if (fsh == event) {
-			break;
-		}
+/*
+ * Sense-reversing barrier closing each time slot. A device flips its
+ * own sense and counts itself out of [nr_left]; the last one to arrive
+ * advances the time and publishes its sense in [slot_sense], which
+ * releases every device sleeping on that futex word.
+ */
+static int nr_devs = 0;		// devices still attached
+static int nr_left = 0;		// devices yet to arrive in this slot
+static int slot_sense = 0;
+static uint64_t slot_wakeup = TIMER_IDLE_FOREVER;
+
+static void futex_wait(int * addr, int val) {
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake_all(int * addr) {
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Run by the last device of the slot while the others are waiting */
+static void end_slot(int sense) {
+	/* Increase the time slot */
+	uint64_t time = _time + 1;
+#ifdef TIMER_FASTFWD
+	/* Nobody worked in this slot: skip to the first wake up */
+	if (slot_wakeup != TIMER_IDLE_FOREVER && slot_wakeup > time) {
+		time = slot_wakeup;
+	}
+#endif
+	/* The events logged in the slot happen before the new time */
+	__atomic_store_n(&_time, time, __ATOMIC_RELEASE);
+	slot_wakeup = TIMER_IDLE_FOREVER;
+	nr_left = nr_devs;
+	if (nr_devs > 0) {
+		evlog_slot(time);
+	}
+
+	/* Let devices continue their job */
+	__atomic_store_n(&slot_sense, sense, __ATOMIC_RELEASE);
+	futex_wake_all(&slot_sense);
+}
+
+/* Count the device out of the current slot, return its new sense */
+static int arrive(struct timer_id_t * timer_id) {
+	int sense = !timer_id->sense;
+
+	timer_id->sense = sense;
+	if (__atomic_sub_fetch(&nr_left, 1, __ATOMIC_ACQ_REL) == 0) {
+		end_slot(sense);
 	}
-	pthread_exit(args);
+	return sense;
 }
 
 void next_slot(struct timer_id_t * timer_id) {
+	next_slot_idle(timer_id, 0);
+}
+
+void next_slot_idle(struct timer_id_t * timer_id, uint64_t until) {
+	uint64_t wakeup = __atomic_load_n(&slot_wakeup, __ATOMIC_RELAXED);
+	int sense, spin;
+
+	while (until < wakeup && !__atomic_compare_exchange_n(&slot_wakeup,
+			&wakeup, until, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+
 	/* Tell to timer that we have done our job in current slot */
-	pthread_mutex_lock(&timer_id->event_lock);
-	timer_id->done = 1;
-	pthread_cond_signal(&timer_id->event_cond);
-	pthread_mutex_unlock(&timer_id->event_lock);
+	sense = arrive(timer_id);
 
 	/* Wait for going to next slot */
-	pthread_mutex_lock(&timer_id->timer_lock);
-	while (timer_id->done) {
-		pthread_cond_wait(
-			&timer_id->timer_cond,
-			&timer_id->timer_lock
-		);
+	for (spin = 0; spin < TIMER_SPIN; spin++) {
+		if (__atomic_load_n(&slot_sense, __ATOMIC_ACQUIRE) == sense)
+			return;
+	}
+	while (__atomic_load_n(&slot_sense, __ATOMIC_ACQUIRE) != sense) {
+		futex_wait(&slot_sense, !sense);
 	}
-	pthread_mutex_unlock(&timer_id->timer_lock);
 }
 
 uint64_t current_time() {
-	return _time;
+	return __atomic_load_n(&_time, __ATOMIC_ACQUIRE);
 }
 
 void start_timer() {
 	timer_started = 1;
-	pthread_create(&_timer, NULL, timer_routine, NULL);
+	nr_left = nr_devs;
+	evlog_slot(current_time());
 }
 
 void detach_event(struct timer_id_t * event) {
-	pthread_mutex_lock(&event->event_lock);
 	event->fsh = 1;
-	pthread_cond_signal(&event->event_cond);
-	pthread_mutex_unlock(&event->event_lock);
+	__atomic_sub_fetch(&nr_devs, 1, __ATOMIC_ACQ_REL);
+	arrive(event);
 }
 
 struct timer_id_t * attach_event() {
@@ -98,14 +123,11 @@ struct timer_id_t * attach_event() {
 	}else{
 		struct timer_id_container_t * container =
 			(struct timer_id_container_t*)malloc(
-				sizeof(struct timer_id_container_t)		
+				sizeof(struct timer_id_container_t)
 			);
-		container->id.done = 0;
+		container->id.sense = slot_sense;
 		container->id.fsh = 0;
-		pthread_cond_init(&container->id.event_cond, NULL);
-		pthread_mutex_init(&container->id.event_lock, NULL);
-		pthread_cond_init(&container->id.timer_cond, NULL);
-		pthread_mutex_init(&container->id.timer_lock, NULL);
+		nr_devs++;
 		if (dev_list == NULL) {
 			dev_list = container;
 			dev_list->next = NULL;
@@ -118,17 +140,13 @@ struct timer_id_t * attach_event() {
 }
 
 void stop_timer() {
-	timer_stop = 1;
-	pthread_join(_timer, NULL);
 	while (dev_list != NULL) {
 		struct timer_id_container_t * temp = dev_list;
 		dev_list = dev_list->next;
-		pthread_cond_destroy(&temp->id.event_cond);
-		pthread_mutex_destroy(&temp->id.event_lock);
-		pthread_cond_destroy(&temp->id.timer_cond);
-		pthread_mutex_destroy(&temp->id.timer_lock);
 		free(temp);
 	}
+	timer_started = 0;
+	_time = 0;
 }
 
 
@@ -0,0 +1,314 @@
+/*
+ * Synthetic workload generator
+ * Write the config input/<name> and the programs input/proc/<name>.<i>
+ * of a workload described by a few parameters, for scheduler and
+ * paging benchmarks.
+ *
+ * Usage: wlgen [options] <name>
+ *   -n <procs>      number of processes (16)
+ *   -u <programs>   distinct programs, process i runs i % u (8)
+ *   -c <cpus>       number of CPUs (2)
+ *   -q <slice>      time slice (2)
+ *   -i <ipc>        instructions per slot, 0 to leave it out (0)
+ *   -a <arrival>    burst | uniform:<span> | poisson:<mean gap> (poisson:1)
+ *   -p <mix>        priority mix <prio>:<weight>,... (uniform)
+ *   -l <length>     instructions of the body of a program (100)
+ *   -R <repeat>     run the body <repeat> times with a loop (1)
+ *   -r <ratios>     calc:alloc:read:write weights of the body (70:5:15:10)
+ *   -w <bytes>      working set of a program, 0 for CPU only (4096)
+ *   -L <locality>   seq | uniform | zipf[:<s>] of the accesses (seq)
+ *   -M <bytes>      size of MEMRAM (1048576)
+ *   -S <bytes>      size of the first MEMSWP (16777216)
+ *   -s <seed>       random seed (1)
+ *   -o <dir>        input directory (input)
+ */
+
+#include "common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WL_REGIONS	8	// Regions holding the working set, regs 0..7
+#define WL_DATA_REG	8	// Destination of the reads
+#define WL_LOOP_REG	9	// Counter of the body loop
+#define WL_BLOCK	256	// Unit of the zipf locality, a page of the mm
+
+enum { ARR_BURST, ARR_UNIFORM, ARR_POISSON };
+enum { LOC_SEQ, LOC_UNIFORM, LOC_ZIPF };
+
+static int nr_procs = 16, nr_progs = 8, nr_cpus = 2, time_slice = 2, ipc = 0;
+static int arrival = ARR_POISSON;
+static double arrival_arg = 1;
+static int mix_prio[MAX_PRIO];
+static double mix_weight[MAX_PRIO];
+static int mix_len = 0;
+static long length = 100, repeat = 1;
+static double ratio[4] = { 70, 5, 15, 10 };	// calc, alloc, read, write
+static long wset = 4096;
+static int locality = LOC_SEQ;
+static double zipf_s = 1.0;
+static long ramsz = 0x100000, swpsz = 0x1000000;
+static const char * dir = "input";
+
+/* Cumulative distribution of the zipf blocks */
+static double * zipf_cdf;
+static long zipf_nr;
+
+static double urand(void) {
+	return (rand() + 0.5) / ((double)RAND_MAX + 1);
+}
+
+/* Index drawn from [n] weights */
+static int pick(const double * weight, int n) {
+	double sum = 0, x;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += weight[i];
+	x = urand() * sum;
+	for (i = 0; i < n - 1; i++) {
+		if (x < weight[i])
+			return i;
+		x -= weight[i];
+	}
+	return n - 1;
+}
+
+static int pick_prio(void) {
+	if (mix_len == 0)
+		return rand() % MAX_PRIO;
+	return mix_prio[pick(mix_weight, mix_len)];
+}
+
+static void zipf_init(void) {
+	double sum = 0;
+	long i;
+
+	zipf_nr = (wset + WL_BLOCK - 1) / WL_BLOCK;
+	zipf_cdf = (double *)malloc(sizeof(double) * zipf_nr);
+	for (i = 0; i < zipf_nr; i++) {
+		sum += 1 / pow(i + 1, zipf_s);
+		zipf_cdf[i] = sum;
+	}
+	for (i = 0; i < zipf_nr; i++)
+		zipf_cdf[i] /= sum;
+}
+
+/* Next byte of the working set touched by a program */
+static long next_addr(long * cursor) {
+	long lo = 0, hi = zipf_nr - 1, mid, addr;
+	double x;
+
+	switch (locality) {
+	case LOC_SEQ:
+		*cursor = (*cursor + 1) % wset;
+		return *cursor;
+	case LOC_UNIFORM:
+		return (long)(urand() * wset);
+	default:
+		x = urand();
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (zipf_cdf[mid] < x)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		addr = lo * WL_BLOCK + rand() % WL_BLOCK;
+		return addr < wset ? addr : wset - 1;
+	}
+}
+
+/* Write program [idx] of the workload [name] */
+static int gen_prog(const char * name, int idx) {
+	int nreg = wset < WL_REGIONS ? (wset > 0) : WL_REGIONS;
+	long regsz = nreg > 0 ? wset / nreg : 0;
+	long cursor = -1, left, addr, size;
+	char path[512];
+	FILE * f;
+	int r;
+
+	snprintf(path, sizeof(path), "%s/proc/%s.%d", dir, name, idx);
+	if ((f = fopen(path, "w")) == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	/* Header, allocs of the working set, body, loop and frees */
+	size = nreg + length + (repeat > 1 ? 2 : 0) + nreg;
+	fprintf(f, "%d %ld\n", pick_prio(), size);
+	for (r = 0; r < nreg; r++)
+		fprintf(f, "alloc %ld %d\n", regsz, r);
+	if (repeat > 1)
+		fprintf(f, "set %d %ld\n", WL_LOOP_REG, repeat);
+	for (left = length; left > 0; left--) {
+		switch (nreg > 0 ? pick(ratio, 4) : 0) {
+		case 1:
+			/* Region churn, a free and an alloc */
+			if (left >= 2) {
+				r = rand() % nreg;
+				fprintf(f, "free %d\nalloc %ld %d\n", r, regsz, r);
+				left--;
+				break;
+			}
+			/* fall through */
+		case 0:
+			fprintf(f, "calc\n");
+			break;
+		case 2:
+			addr = next_addr(&cursor);
+			fprintf(f, "read %ld %ld %d\n",
+				addr / regsz % nreg, addr % regsz, WL_DATA_REG);
+			break;
+		default:
+			addr = next_addr(&cursor);
+			fprintf(f, "write %d %ld %ld\n", rand() % 256,
+				addr / regsz % nreg, addr % regsz);
+			break;
+		}
+	}
+	if (repeat > 1)
+		fprintf(f, "loop %d %d\n", WL_LOOP_REG, nreg + 1);
+	for (r = 0; r < nreg; r++)
+		fprintf(f, "free %d\n", r);
+	fclose(f);
+	return 0;
+}
+
+/* Write the config of the workload [name] */
+static int gen_config(const char * name) {
+	double t = 0;
+	char path[512];
+	FILE * f;
+	int i;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if ((f = fopen(path, "w")) == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	fprintf(f, "%d %d %d", time_slice, nr_cpus, nr_procs);
+	if (ipc > 0)
+		fprintf(f, " %d", ipc);
+	fprintf(f, "\n");
+#if defined(MM_PAGING) && !defined(MM_FIXED_MEMSZ)
+	fprintf(f, "%ld %ld", ramsz, swpsz);
+	for (i = 1; i < PAGING_MAX_MMSWP; i++)
+		fprintf(f, " 0");
+	fprintf(f, "\n");
+#endif
+
+	for (i = 0; i < nr_procs; i++) {
+		switch (arrival) {
+		case ARR_BURST:
+			break;
+		case ARR_UNIFORM:
+			t = (long)(urand() * arrival_arg);
+			break;
+		default:
+			t += -log(urand()) * arrival_arg;
+			break;
+		}
+		fprintf(f, "%ld %s.%d", (long)t, name, i % nr_progs);
+#ifdef MLQ_SCHED
+		fprintf(f, " %d", pick_prio());
+#endif
+		fprintf(f, "\n");
+	}
+	fclose(f);
+	return 0;
+}
+
+static int parse_mix(char * arg) {
+	char * tok;
+
+	for (tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		if (mix_len == MAX_PRIO ||
+		    sscanf(tok, "%d:%lf", &mix_prio[mix_len],
+			   &mix_weight[mix_len]) != 2 ||
+		    mix_prio[mix_len] < 0 || mix_prio[mix_len] >= MAX_PRIO)
+			return 1;
+		mix_len++;
+	}
+	return mix_len == 0;
+}
+
+static int parse_arrival(const char * arg) {
+	if (!strcmp(arg, "burst"))
+		arrival = ARR_BURST;
+	else if (sscanf(arg, "uniform:%lf", &arrival_arg) == 1)
+		arrival = ARR_UNIFORM;
+	else if (sscanf(arg, "poisson:%lf", &arrival_arg) == 1)
+		arrival = ARR_POISSON;
+	else
+		return 1;
+	return arrival_arg < 0;
+}
+
+static int parse_locality(const char * arg) {
+	if (!strcmp(arg, "seq"))
+		locality = LOC_SEQ;
+	else if (!strcmp(arg, "uniform"))
+		locality = LOC_UNIFORM;
+	else if (!strcmp(arg, "zipf") || sscanf(arg, "zipf:%lf", &zipf_s) == 1)
+		locality = LOC_ZIPF;
+	else
+		return 1;
+	return 0;
+}
+
+int main(int argc, char * argv[]) {
+	unsigned seed = 1;
+	int opt, bad = 0, i;
+
+	while ((opt = getopt(argc, argv, "n:u:c:q:i:a:p:l:R:r:w:L:M:S:s:o:")) != -1) {
+		switch (opt) {
+		case 'n': nr_procs = atoi(optarg); break;
+		case 'u': nr_progs = atoi(optarg); break;
+		case 'c': nr_cpus = atoi(optarg); break;
+		case 'q': time_slice = atoi(optarg); break;
+		case 'i': ipc = atoi(optarg); break;
+		case 'a': bad |= parse_arrival(optarg); break;
+		case 'p': bad |= parse_mix(optarg); break;
+		case 'l': length = atol(optarg); break;
+		case 'R': repeat = atol(optarg); break;
+		case 'r':
+			bad |= sscanf(optarg, "%lf:%lf:%lf:%lf", &ratio[0],
+				      &ratio[1], &ratio[2], &ratio[3]) != 4;
+			break;
+		case 'w': wset = atol(optarg); break;
+		case 'L': bad |= parse_locality(optarg); break;
+		case 'M': ramsz = atol(optarg); break;
+		case 'S': swpsz = atol(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		case 'o': dir = optarg; break;
+		default: bad = 1; break;
+		}
+	}
+	if (bad || optind != argc - 1 || nr_procs < 1 || nr_progs < 1 ||
+	    length < 0 || repeat < 1 || wset < 0) {
+		printf("Usage: wlgen [-n procs] [-u programs] [-c cpus] [-q slice]"
+		       " [-i ipc]\n"
+		       "             [-a burst|uniform:<span>|poisson:<gap>]"
+		       " [-p prio:weight,...]\n"
+		       "             [-l length] [-R repeat] [-r calc:alloc:read:write]"
+		       " [-w bytes]\n"
+		       "             [-L seq|uniform|zipf[:s]] [-M ram] [-S swap]"
+		       " [-s seed] [-o dir] <name>\n");
+		return 1;
+	}
+	if (nr_progs > nr_procs)
+		nr_progs = nr_procs;
+
+	srand(seed);
+	if (locality == LOC_ZIPF && wset > 0)
+		zipf_init();
+	for (i = 0; i < nr_progs; i++) {
+		if (gen_prog(argv[optind], i) != 0)
+			return 1;
+	}
+	return gen_config(argv[optind]);
+}